@@ -0,0 +1,256 @@
+/*
+ * Host microbenchmarks of the command path (native build)
+ *
+ * Drives MQTTcallback and slot database functions with realistic payloads
+ * against the in-memory SPIFFS stand-in and reports time and heap
+ * allocations per operation. Checks of queued macros run first and every
+ * benchmark checks that TX queue neither rejected nor dropped a job, failed
+ * check stops the program with non-zero status:
+ *   pio run -e native && .pio/build/native/program
+ */
+#include "globals.h"
+#include <chrono>
+#include <new>
+
+static unsigned long allocCount = 0;
+static unsigned long allocBytes = 0;
+
+void* operator new(size_t size)
+{
+  allocCount++;
+  allocBytes += size;
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+/* **************************************************************
+ * Payloads
+ */
+static char topicSendRaw[100];
+static char topicSendRawB[100];
+static char topicSendGC[100];
+static char topicNEC[100];
+static char topicSendSeq[100];
+static char topicStoreRaw[100];
+static std::string payloadRaw;      // 300 durations + frequency
+static std::string payloadRawB;     // the same in compact binary format
+static std::string payloadGC;
+static std::string payloadNEC = "551549190";
+static std::string payloadSeq = "1,2,3,4,5,6,7,8,9,10"; // distinct slots of SLOT_SIZE durations
+static uint16_t slotData[SLOT_SIZE+1];
+static volatile uint16_t captureBuf[SLOT_SIZE+1];
+
+/* **************************************************************
+ * NEC-like frame: header, 32 bits, repeated to given length
+ */
+static void buildPayloads()
+{
+  snprintf(topicSendRaw, sizeof(topicSendRaw), "%s%s", mqtt_prefix, SUFFIX_SENDRAW);
+  snprintf(topicSendRawB, sizeof(topicSendRawB), "%s%s", mqtt_prefix, SUFFIX_SENDRAWB);
+  snprintf(topicSendGC, sizeof(topicSendGC), "%s%s", mqtt_prefix, SUFFIX_SENDGC);
+  snprintf(topicNEC, sizeof(topicNEC), "%s/sender/NEC/32", mqtt_prefix);
+  snprintf(topicSendSeq, sizeof(topicSendSeq), "%s%s", mqtt_prefix, SUFFIX_SENDSTORERAWSEQ);
+  snprintf(topicStoreRaw, sizeof(topicStoreRaw), "%s%s/1", mqtt_prefix, SUFFIX_STORERAW);
+
+  captureBuf[0] = 0;
+  for (int i=0;i<SLOT_SIZE;i++)
+  {
+    uint16_t value;
+    if (i % 68 == 0)
+      value = 9000;
+    else if (i % 68 == 1)
+      value = 4500;
+    else if (i % 2 == 0)
+      value = 560 + (i % 3) * 10;
+    else
+      value = (i % 5 < 2) ? 1690 : 560;
+    slotData[i] = value;
+    captureBuf[i+1] = value / RAWTICK;
+    payloadRaw += std::to_string(value) + ",";
+  }
+  slotData[SLOT_SIZE] = 38;
+  payloadRaw += "38";
+
+  payloadGC = "38000,1,69,343,172";
+  for (int i=0;i<64;i++)
+    payloadGC += (i % 3) ? ",21,22" : ",21,65";
+  payloadGC += ",21,1673,343,86,21,3732";
+
+  struct StringOut : public Print {
+    std::string *out;
+    size_t write(uint8_t c) override { *out += (char) c; return 1; }
+  } out;
+  out.out = &payloadRawB;
+  writeRawBinary(out, captureBuf+1, SLOT_SIZE, 38);
+}
+
+/* **************************************************************
+ * NEC frame of given code: header, 32 bits, stop mark, frequency
+ * @returns number of elements
+ */
+static int buildNECFrame(uint16_t data[], uint32_t code)
+{
+  int count = 0;
+  data[count++] = 9000;
+  data[count++] = 4500;
+  for (int bit=31;bit>=0;bit--)
+  {
+    data[count++] = 560;
+    data[count++] = (code >> bit) & 1 ? 1690 : 560;
+  }
+  data[count++] = 560;
+  data[count++] = 40000;
+  data[count++] = 38;
+  return count;
+}
+
+/* **************************************************************
+ * Store distinct slots: from..to, each of given number of durations
+ */
+static void storeDistinctSlots(int from, int to, int durations)
+{
+  for (int slotNo=from;slotNo<=to;slotNo++)
+  {
+    uint16_t data[SLOT_SIZE+1];
+    uint16_t frame[70];
+    int frameSize = buildNECFrame(frame, 0x20DF0000 + slotNo*0x0101) - 1;
+    for (int i=0;i<durations;i++)
+      data[i] = frame[i % frameSize];
+    data[durations] = 38;
+    slotDbWrite(slotNo, data, durations+1);
+  }
+}
+
+/* **************************************************************
+ * Stop when check fails
+ */
+static void check(bool condition, const char *what)
+{
+  if (condition)
+    return;
+  printf("FAILED: %s (%s)\n", what, txQueueInfo().c_str());
+  exit(1);
+}
+
+/* **************************************************************
+ * Number after given key in info string (e.g. "Misses=")
+ */
+static long infoValue(const String &info, const char *key)
+{
+  const char *value = strstr(info.c_str(), key);
+  return value ? atol(value + strlen(key)) : -1;
+}
+
+/* **************************************************************
+ * Send all queued frames
+ */
+static void drainTxQueue()
+{
+  while (txQueueDepth() > 0)
+  {
+    hostAdvanceMillis(1000);
+    txQueueRun();
+  }
+}
+
+static void callback(char *topic, std::string &payload)
+{
+  MQTTcallback(topic, (byte *) &payload[0], payload.size());
+}
+
+/* **************************************************************
+ * Benchmarks
+ */
+static void benchSendRaw()       { callback(topicSendRaw, payloadRaw); drainTxQueue(); }
+static void benchSendRawB()      { callback(topicSendRawB, payloadRawB); drainTxQueue(); }
+static void benchSendGC()        { callback(topicSendGC, payloadGC); drainTxQueue(); }
+static void benchSendNEC()       { callback(topicNEC, payloadNEC); drainTxQueue(); }
+static void benchSendSeq()
+{
+  callback(topicSendSeq, payloadSeq);
+  check(txQueueDepth() == 10, "sequence not queued");
+  drainTxQueue();
+}
+static void benchStoreRaw()      { callback(topicStoreRaw, payloadRaw); }
+static void benchSlotDbWrite()
+{
+  uint16_t data[SLOT_SIZE+1];
+  memcpy(data, slotData, sizeof(data));
+  slotDbWrite(SLOTS_NUMBER, data, SLOT_SIZE+1);
+}
+static void benchSlotDbRead()    { slotDbRead(SLOTS_NUMBER, rawIrData); }
+static void benchPublishRaw()    { publishRawDurations("bench/receiver/raw", captureBuf, SLOT_SIZE+1); }
+static void benchPublishRawB()   { publishRawBinary("bench/receiver/rawb", captureBuf, SLOT_SIZE+1); }
+
+/* **************************************************************
+ * Sequence of distinct slots is queued whole and sent from slot cache
+ * - steps - number of steps of payload
+ */
+static void checkSequence(const char *payload, int steps)
+{
+  std::string msg = payload;
+  callback(topicSendSeq, msg);
+  check(txQueueDepth() == steps, payload);
+  check(infoValue(txQueueInfo(), "Rejected=") == 0, payload);
+  long misses = infoValue(slotCacheInfo(), "Misses=");
+  drainTxQueue();
+  check(infoValue(slotCacheInfo(), "Misses=") == misses, "slot read while macro is sent");
+}
+
+static void checkMacros()
+{
+  storeDistinctSlots(11, 14, 300);
+  checkSequence("11,12,13,14", 4);
+  storeDistinctSlots(21, 20+MACRO_STEPS, 68);
+  std::string steps;
+  for (int slotNo=21;slotNo<=20+MACRO_STEPS;slotNo++)
+    steps += (steps.empty() ? "" : ",") + std::to_string(slotNo) + "*2@30";
+  checkSequence(steps.c_str(), MACRO_STEPS);
+}
+
+static void bench(const char *name, unsigned long iterations, void (*fn)())
+{
+  fn(); // warm up (cache, file creation)
+  unsigned long allocCountStart = allocCount;
+  unsigned long allocBytesStart = allocBytes;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i=0;i<iterations;i++)
+    fn();
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+  printf("%-28s %10lu %12.0f %10.1f %12.1f\n", name, iterations, ns,
+    (double) (allocCount - allocCountStart) / iterations,
+    (double) (allocBytes - allocBytesStart) / iterations);
+  String info = txQueueInfo();
+  check(infoValue(info, "Rejected=") == 0 && infoValue(info, "Dropped=") == 0, name);
+}
+
+int main()
+{
+  strcpy(mqtt_prefix, "bench/ir");
+  SPIFFS.begin();
+  buildPayloads();
+  storeDistinctSlots(1, 10, SLOT_SIZE);
+
+  checkMacros();
+
+  printf("%-28s %10s %12s %10s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+  bench("MQTTcallback sendRAW", 2000, benchSendRaw);
+  bench("MQTTcallback sendRAWb", 2000, benchSendRawB);
+  bench("MQTTcallback sendGC", 2000, benchSendGC);
+  bench("MQTTcallback NEC", 20000, benchSendNEC);
+  bench("MQTTcallback sendStoredRawSeq", 2000, benchSendSeq);
+  bench("MQTTcallback storeRaw", 500, benchStoreRaw);
+  bench("slotDbWrite", 2000, benchSlotDbWrite);
+  bench("slotDbRead", 2000, benchSlotDbRead);
+  bench("publishRawDurations", 2000, benchPublishRaw);
+  bench("publishRawBinary", 2000, benchPublishRawB);
+  return 0;
+}
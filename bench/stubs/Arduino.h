@@ -0,0 +1,121 @@
+#pragma once
+// Host stand-in for Arduino core used by the native build
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <memory>
+
+typedef uint8_t byte;
+typedef bool boolean;
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define HEX 16
+#define DEC 10
+#define CHANGE 3
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+#define F(x) x
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void pinMode(uint8_t pin, uint8_t mode);
+long random(long max);
+long random(long min, long max);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+#define digitalPinToInterrupt(p) (p)
+
+// Host helpers
+void hostAdvanceMillis(unsigned long ms); // move millis() forward (skip transmit gaps)
+
+class String {
+ public:
+  std::string s;
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& c) : s(c) {}
+  String(char c) : s(1, c) {}
+  String(int v, unsigned char base = 10);
+  String(unsigned int v, unsigned char base = 10);
+  String(long v, unsigned char base = 10);
+  String(unsigned long v, unsigned char base = 10);
+  String(float v, unsigned char decimals = 2);
+  String(double v, unsigned char decimals = 2);
+  unsigned int length() const { return s.size(); }
+  const char* c_str() const { return s.c_str(); }
+  char charAt(unsigned int i) const { return s[i]; }
+  char operator[](unsigned int i) const { return s[i]; }
+  String substring(unsigned int from) const { return from > s.size() ? String() : String(s.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const { return String(s.substr(from, to - from)); }
+  int indexOf(char c, unsigned int from = 0) const { size_t p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const char* c, unsigned int from = 0) const { size_t p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  long toInt() const { return atol(s.c_str()); }
+  void toCharArray(char* buf, unsigned int n) const { strncpy(buf, s.c_str(), n); buf[n - 1] = 0; }
+  bool reserve(unsigned int n) { s.reserve(n); return true; }
+  bool startsWith(const String& o) const { return s.compare(0, o.s.size(), o.s) == 0; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator==(const char* o) const { return s == o; }
+  bool operator!=(const char* o) const { return s != o; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(char o) { s += o; return *this; }
+  String& operator+=(int o) { s += std::to_string(o); return *this; }
+  String& operator+=(unsigned int o) { s += std::to_string(o); return *this; }
+  String& operator+=(long o) { s += std::to_string(o); return *this; }
+  String& operator+=(unsigned long o) { s += std::to_string(o); return *this; }
+  friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+  friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+  friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+  friend String operator+(const String& a, int b) { return String(a.s + std::to_string(b)); }
+  friend String operator+(const String& a, unsigned int b) { return String(a.s + std::to_string(b)); }
+  friend String operator+(const String& a, long b) { return String(a.s + std::to_string(b)); }
+  friend String operator+(const String& a, unsigned long b) { return String(a.s + std::to_string(b)); }
+  friend String operator+(const String& a, char b) { return String(a.s + b); }
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n) { size_t i = 0; for (; i < n; i++) write(buf[i]); return i; }
+  size_t print(const char* c) { return write((const uint8_t*)c, strlen(c)); }
+  size_t print(const String& c) { return print(c.c_str()); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(char* buf, size_t n) { size_t i = 0; while (i < n && available()) buf[i++] = read(); return i; }
+  size_t readBytes(uint8_t* buf, size_t n) { return readBytes((char*)buf, n); }
+  String readStringUntil(char terminator) { String r; while (available()) { int c = read(); if (c == terminator) break; r += (char)c; } return r; }
+};
+
+#define SERIAL_8N1 0
+#define SERIAL_TX_ONLY 1
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long, int = 0, int = 0) {}
+  size_t write(uint8_t) override { return 1; }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+extern HardwareSerial Serial;
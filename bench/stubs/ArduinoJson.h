@@ -0,0 +1,60 @@
+#pragma once
+// Host stand-in for ArduinoJson 5 (API only, parsing always fails) used by the native build
+#include "Arduino.h"
+class JsonArray;
+class JsonObject;
+class JsonVariant {
+ public:
+  JsonVariant() {}
+  template <typename T> JsonVariant(T) {}
+  template <typename T> bool is() const { return false; }
+  template <typename T> T as() const { return T(); }
+  operator const char*() const { return ""; }
+  operator long() const { return 0; }
+  operator int() const { return 0; }
+  operator unsigned long() const { return 0; }
+  operator bool() const { return false; }
+  operator JsonArray&() const;
+  operator JsonObject&() const;
+  template <typename T> JsonVariant& operator=(T) { return *this; }
+  JsonVariant operator[](const char*) const { return JsonVariant(); }
+  JsonVariant operator[](size_t) const { return JsonVariant(); }
+  bool success() const { return false; }
+  template <typename T> T operator|(T d) const { return d; }
+};
+class JsonObject {
+ public:
+  bool success() const { return false; }
+  bool containsKey(const char*) const { return false; }
+  JsonVariant operator[](const char*) { return JsonVariant(); }
+  JsonVariant get(const char*) const { return JsonVariant(); }
+  template <typename T> T get(const char*) const { return T(); }
+  size_t printTo(char*, size_t) const { return 0; }
+  size_t printTo(Print&) const { return 0; }
+  size_t measureLength() const { return 0; }
+  template <typename T> bool set(const char*, T) { return true; }
+  JsonArray& createNestedArray(const char*);
+};
+class JsonArray {
+ public:
+  bool success() const { return false; }
+  size_t size() const { return 0; }
+  JsonVariant operator[](size_t) const { return JsonVariant(); }
+  JsonVariant* begin() { return nullptr; }
+  JsonVariant* end() { return nullptr; }
+  template <typename T> bool add(T) { return true; }
+  size_t printTo(char*, size_t) const { return 0; }
+};
+class DynamicJsonBuffer {
+ public:
+  DynamicJsonBuffer(size_t = 0) {}
+  JsonObject& parseObject(const char*) { static JsonObject o; return o; }
+  JsonObject& parseObject(const uint8_t*, size_t = 0) { static JsonObject o; return o; }
+  JsonArray& parseArray(const char*) { static JsonArray a; return a; }
+  JsonArray& parseArray(char*, size_t) { static JsonArray a; return a; }
+  JsonObject& createObject() { static JsonObject o; return o; }
+  JsonArray& createArray() { static JsonArray a; return a; }
+};
+inline JsonVariant::operator JsonArray&() const { static JsonArray a; return a; }
+inline JsonVariant::operator JsonObject&() const { static JsonObject o; return o; }
+inline JsonArray& JsonObject::createNestedArray(const char*) { static JsonArray a; return a; }
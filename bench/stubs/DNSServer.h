@@ -0,0 +1,2 @@
+#pragma once
+// Host stand-in for DNSServer used by the native build
@@ -0,0 +1,12 @@
+#pragma once
+// Host stand-in for ESP8266 EEPROM used by the native build
+#include "Arduino.h"
+class EEPROMClass {
+ public:
+  uint8_t data[512];
+  void begin(size_t) {}
+  template <typename T> T& get(int a, T& t) { memcpy(&t, data + a, sizeof(T)); return t; }
+  template <typename T> const T& put(int a, const T& t) { memcpy(data + a, &t, sizeof(T)); return t; }
+  bool commit() { return true; }
+};
+extern EEPROMClass EEPROM;
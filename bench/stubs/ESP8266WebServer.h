@@ -0,0 +1,2 @@
+#pragma once
+// Host stand-in for ESP8266WebServer used by the native build
@@ -0,0 +1,66 @@
+#pragma once
+// Host stand-in for ESP8266 core (ESP, WiFi, clients) used by the native build
+#include "Arduino.h"
+typedef enum { FM_QIO, FM_QOUT, FM_DIO, FM_DOUT, FM_UNKNOWN } FlashMode_t;
+class EspClass {
+ public:
+  uint32_t getChipId() { return 0x123456; }
+  uint32_t getFlashChipId() { return 0x1640ef; }
+  uint32_t getFlashChipRealSize() { return 1048576; }
+  uint32_t getFlashChipSize() { return 1048576; }
+  FlashMode_t getFlashChipMode() { return FM_DOUT; }
+  uint32_t getFreeHeap() { return 30000; }
+  uint32_t getMaxFreeBlockSize() { return 20000; }
+  uint8_t getHeapFragmentation() { return 5; }
+  uint32_t getFreeContStack() { return 3000; }
+  String getResetReason() { return "Power on"; }
+  uint32_t getCycleCount() { return 0; }
+  bool rtcUserMemoryRead(uint32_t, uint32_t*, size_t) { return false; }
+  bool rtcUserMemoryWrite(uint32_t, uint32_t*, size_t) { return true; }
+  void restart() {}
+  void reset() {}
+};
+extern EspClass ESP;
+class IPAddress {
+ public:
+  uint8_t b[4];
+  IPAddress() : b{0,0,0,0} {}
+  IPAddress(uint8_t a, uint8_t c, uint8_t d, uint8_t e) : b{a,c,d,e} {}
+  IPAddress(uint32_t v) { memcpy(b, &v, 4); }
+  operator uint32_t() const { uint32_t v; memcpy(&v, b, 4); return v; }
+  uint8_t operator[](int i) const { return b[i]; }
+};
+class Client : public Stream {
+ public:
+  virtual int connect(const char*, uint16_t) { return 1; }
+  virtual uint8_t connected() { return 1; }
+  virtual void stop() {}
+  size_t write(uint8_t) override { return 1; }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+class WiFiClient : public Client {};
+class WiFiClientSecure : public WiFiClient {};
+#define WL_CONNECTED 3
+#define WIFI_STA 1
+class ESP8266WiFiClass {
+ public:
+  String SSID() { return "ssid"; }
+  String psk() { return "psk"; }
+  IPAddress localIP() { return IPAddress(192,168,1,10); }
+  IPAddress gatewayIP() { return IPAddress(); }
+  IPAddress subnetMask() { return IPAddress(); }
+  IPAddress dnsIP(uint8_t = 0) { return IPAddress(); }
+  uint8_t* BSSID() { static uint8_t b[6]; return b; }
+  int32_t channel() { return 1; }
+  int32_t RSSI() { return -50; }
+  void macAddress(uint8_t* m) { memset(m, 0, 6); }
+  int status() { return WL_CONNECTED; }
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress()) { return true; }
+  int begin(const char*, const char*, int32_t = 0, const uint8_t* = nullptr, bool = true) { return WL_CONNECTED; }
+  bool mode(int) { return true; }
+  bool persistent(bool) { return true; }
+};
+extern ESP8266WiFiClass WiFi;
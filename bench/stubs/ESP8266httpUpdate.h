@@ -0,0 +1,11 @@
+#pragma once
+// Host stand-in for ESP8266httpUpdate used by the native build
+#include "Arduino.h"
+typedef enum { HTTP_UPDATE_FAILED, HTTP_UPDATE_NO_UPDATES, HTTP_UPDATE_OK } t_httpUpdate_return;
+class ESP8266HTTPUpdate {
+ public:
+  t_httpUpdate_return update(const String&) { return HTTP_UPDATE_NO_UPDATES; }
+  int getLastError() { return 0; }
+  String getLastErrorString() { return ""; }
+};
+extern ESP8266HTTPUpdate ESPhttpUpdate;
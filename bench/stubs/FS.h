@@ -0,0 +1,46 @@
+#pragma once
+// Host stand-in for SPIFFS (in-memory file system) used by the native build
+#include "Arduino.h"
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+struct FSInfo { size_t totalBytes; size_t usedBytes; size_t blockSize; size_t pageSize; size_t maxOpenFiles; size_t maxPathLength; };
+struct MemFile;
+class File : public Stream {
+ public:
+  std::shared_ptr<MemFile> f; size_t pos = 0; bool canWrite = false; std::string path;
+  File() {}
+  explicit operator bool() const { return (bool)f; }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* b, size_t n) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* b, size_t n);
+  bool seek(uint32_t p, SeekMode m = SeekSet);
+  size_t position() const { return pos; }
+  size_t size() const;
+  void flush() {}
+  void close() { f.reset(); }
+  const char* name() const { return path.c_str(); }
+};
+class Dir {
+ public:
+  std::string prefix; int idx = -1;
+  bool next();
+  String fileName();
+  size_t fileSize();
+  File openFile(const char* mode);
+};
+class FS {
+ public:
+  bool begin();
+  bool exists(const char* p);
+  bool exists(const String& p) { return exists(p.c_str()); }
+  bool remove(const char* p);
+  bool remove(const String& p) { return remove(p.c_str()); }
+  bool rename(const char* a, const char* b);
+  File open(const char* p, const char* mode);
+  File open(const String& p, const char* mode) { return open(p.c_str(), mode); }
+  Dir openDir(const char* p);
+  bool info(FSInfo& i);
+};
+extern FS SPIFFS;
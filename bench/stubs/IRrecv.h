@@ -0,0 +1,25 @@
+#pragma once
+// Host stand-in for IRremoteESP8266 IRrecv used by the native build
+#include "IRremoteESP8266.h"
+#define RAWTICK 2
+#define RAWBUF 100
+class decode_results {
+ public:
+  decode_type_t decode_type;
+  uint64_t value;
+  uint32_t address;
+  uint32_t command;
+  uint16_t bits;
+  volatile uint16_t* rawbuf;
+  uint16_t rawlen;
+  bool overflow;
+  bool repeat;
+};
+class IRrecv {
+ public:
+  explicit IRrecv(uint16_t, uint16_t = RAWBUF) {}
+  bool decode(decode_results*) { return false; }
+  void enableIRIn() {}
+  void disableIRIn() {}
+  void resume() {}
+};
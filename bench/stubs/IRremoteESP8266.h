@@ -0,0 +1,48 @@
+#pragma once
+// Host stand-in for IRremoteESP8266 (protocol list) used by the native build
+#include "Arduino.h"
+#define SEND_NEC true
+#define DECODE_NEC true
+#define SEND_SONY true
+#define DECODE_SONY true
+#define SEND_RC5 true
+#define DECODE_RC5 true
+#define SEND_RC6 true
+#define DECODE_RC6 true
+#define SEND_DISH true
+#define DECODE_DISH true
+#define SEND_SHARP true
+#define DECODE_SHARP true
+#define SEND_JVC true
+#define DECODE_JVC true
+#define SEND_SANYO true
+#define DECODE_SANYO true
+#define SEND_MITSUBISHI true
+#define DECODE_MITSUBISHI true
+#define SEND_SAMSUNG true
+#define DECODE_SAMSUNG true
+#define SEND_LG true
+#define DECODE_LG true
+#define SEND_WHYNTER true
+#define DECODE_WHYNTER true
+#define SEND_PANASONIC true
+#define DECODE_PANASONIC true
+#define SEND_COOLIX true
+#define DECODE_COOLIX true
+#define SEND_DENON true
+#define DECODE_DENON true
+#define SEND_SHERWOOD true
+#define SEND_RCMM true
+#define DECODE_RCMM true
+#define SEND_NIKAI true
+#define DECODE_NIKAI true
+#define SEND_AIWA_RC_T501 true
+#define DECODE_AIWA_RC_T501 true
+#define SEND_GLOBALCACHE true
+#define SEND_RAW true
+enum decode_type_t {
+  UNKNOWN = -1, UNUSED = 0, RC5, RC6, NEC, SONY, PANASONIC, JVC, SAMSUNG, WHYNTER,
+  AIWA_RC_T501, LG, SANYO, MITSUBISHI, DISH, SHARP, COOLIX, DAIKIN, DENON, KELVINATOR,
+  SHERWOOD, MITSUBISHI_AC, RCMM, SANYO_LC7461, RC5X, GREE, PRONTO, NEC_LIKE, ARGO,
+  TROTEC, NIKAI
+};
@@ -0,0 +1,33 @@
+#pragma once
+// Host stand-in for IRremoteESP8266 IRsend used by the native build
+#include "IRremoteESP8266.h"
+
+class IRsend {
+ public:
+  explicit IRsend(uint16_t) {}
+  void begin() {}
+  void enableIROut(uint32_t, uint8_t = 50) {}
+  uint16_t mark(uint16_t) { return 0; }
+  void space(uint32_t) {}
+  void sendRaw(uint16_t[], uint16_t, uint16_t) {}
+  void sendGC(uint16_t[], uint16_t) {}
+  void sendNEC(uint64_t, uint16_t = 32, uint16_t = 0) {}
+  void sendSony(uint64_t, uint16_t = 12, uint16_t = 2) {}
+  void sendRC5(uint64_t, uint16_t = 12, uint16_t = 0) {}
+  void sendRC6(uint64_t, uint16_t = 20, uint16_t = 0) {}
+  void sendDISH(uint64_t, uint16_t = 16, uint16_t = 4) {}
+  void sendSharpRaw(uint64_t, uint16_t = 15, uint16_t = 0) {}
+  void sendJVC(uint64_t, uint16_t = 16, uint16_t = 0) {}
+  void sendSAMSUNG(uint64_t, uint16_t = 32, uint16_t = 0) {}
+  void sendLG(uint64_t, uint16_t = 28, uint16_t = 0) {}
+  void sendWhynter(uint64_t, uint16_t = 32, uint16_t = 0) {}
+  void sendPanasonic64(uint64_t, uint16_t = 48, uint16_t = 0) {}
+  void sendCOOLIX(uint64_t, uint16_t = 24, uint16_t = 0) {}
+  void sendDenon(uint64_t, uint16_t = 14, uint16_t = 0) {}
+  void sendSherwood(uint64_t, uint16_t = 32, uint16_t = 1) {}
+  void sendRCMM(uint64_t, uint16_t = 24, uint16_t = 0) {}
+  void sendMitsubishi(uint64_t, uint16_t = 16, uint16_t = 1) {}
+  void sendSanyoLC7461(uint64_t, uint16_t = 42, uint16_t = 0) {}
+  void sendNikai(uint64_t, uint16_t = 24, uint16_t = 0) {}
+  void sendAiwaRCT501(uint64_t, uint16_t = 15, uint16_t = 1) {}
+};
@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in for IRremoteESP8266 IRutils used by the native build
+#include "IRremoteESP8266.h"
@@ -0,0 +1,8 @@
+#pragma once
+// Host stand-in for ESP8266 Ticker (callbacks are never called)
+#include "Arduino.h"
+class Ticker {
+ public:
+  void attach_ms(uint32_t, void (*)(void)) {}
+  void detach() {}
+};
@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in for WiFiClient used by the native build
+#include "ESP8266WiFi.h"
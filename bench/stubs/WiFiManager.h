@@ -0,0 +1,18 @@
+#pragma once
+// Host stand-in for WiFiManager used by the native build
+#include "Arduino.h"
+class WiFiManagerParameter {
+ public:
+  const char* v;
+  WiFiManagerParameter(const char*, const char*, const char* d, int) : v(d) {}
+  const char* getValue() { return v; }
+};
+class WiFiManager {
+ public:
+  void setTimeout(unsigned long) {}
+  void setSaveConfigCallback(void (*)(void)) {}
+  void addParameter(WiFiManagerParameter*) {}
+  void resetSettings() {}
+  void setDebugOutput(bool) {}
+  bool autoConnect(const char*, const char*) { return true; }
+};
@@ -0,0 +1,91 @@
+// Host stand-ins implementation used by the native build
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include "FS.h"
+#include "EEPROM.h"
+#include "ESP8266httpUpdate.h"
+#include "IRsend.h"
+#include "IRrecv.h"
+#include "PubSubClient.h"
+#include <map>
+#include <vector>
+#include <chrono>
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+EEPROMClass EEPROM;
+ESP8266HTTPUpdate ESPhttpUpdate;
+FS SPIFFS;
+
+static auto t0 = std::chrono::steady_clock::now();
+static unsigned long millisOffset = 0;
+unsigned long millis() { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count() + millisOffset; }
+unsigned long micros() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count() + millisOffset * 1000; }
+void hostAdvanceMillis(unsigned long ms) { millisOffset += ms; }
+void delay(unsigned long ms) { millisOffset += ms; }
+void delayMicroseconds(unsigned int) {}
+void yield() {}
+int digitalRead(uint8_t) { return HIGH; }
+void digitalWrite(uint8_t, uint8_t) {}
+void pinMode(uint8_t, uint8_t) {}
+long random(long m) { return m > 0 ? rand() % m : 0; }
+long random(long a, long b) { return b > a ? a + rand() % (b - a) : a; }
+void attachInterrupt(uint8_t, void (*)(void), int) {}
+void detachInterrupt(uint8_t) {}
+String::String(int v, unsigned char base) { char b[40]; if (base == 16) snprintf(b, 40, "%x", v); else snprintf(b, 40, "%d", v); s = b; }
+String::String(unsigned int v, unsigned char base) { char b[40]; snprintf(b, 40, base == 16 ? "%x" : "%u", v); s = b; }
+String::String(long v, unsigned char base) { char b[40]; if (base == 16) snprintf(b, 40, "%lx", v); else snprintf(b, 40, "%ld", v); s = b; }
+String::String(unsigned long v, unsigned char base) { char b[40]; snprintf(b, 40, base == 16 ? "%lx" : "%lu", v); s = b; }
+String::String(float v, unsigned char d) { char b[40]; snprintf(b, 40, "%.*f", d, v); s = b; }
+String::String(double v, unsigned char d) { char b[40]; snprintf(b, 40, "%.*f", d, v); s = b; }
+
+struct MemFile { std::vector<uint8_t> data; };
+static std::map<std::string, std::shared_ptr<MemFile>> files;
+size_t File::write(const uint8_t* b, size_t n) {
+  if (!f || !canWrite) return 0;
+  if (pos + n > f->data.size()) f->data.resize(pos + n);
+  memcpy(f->data.data() + pos, b, n); pos += n; return n;
+}
+int File::available() { return f ? (int)(f->data.size() - pos) : 0; }
+int File::read() { return (f && pos < f->data.size()) ? f->data[pos++] : -1; }
+int File::peek() { return (f && pos < f->data.size()) ? f->data[pos] : -1; }
+size_t File::read(uint8_t* b, size_t n) { if (!f) return 0; size_t a = f->data.size() - pos; if (n > a) n = a; memcpy(b, f->data.data() + pos, n); pos += n; return n; }
+bool File::seek(uint32_t p, SeekMode m) { if (!f) return false; size_t np = m == SeekSet ? p : m == SeekCur ? pos + p : f->data.size() + p; if (np > f->data.size()) return false; pos = np; return true; }
+size_t File::size() const { return f ? f->data.size() : 0; }
+bool FS::begin() { return true; }
+bool FS::exists(const char* p) { return files.count(p) > 0; }
+bool FS::remove(const char* p) { return files.erase(p) > 0; }
+bool FS::rename(const char* a, const char* b) { if (!files.count(a) || files.count(b)) return false; files[b] = files[a]; files.erase(a); return true; }
+File FS::open(const char* p, const char* mode) {
+  File r; r.path = p;
+  if (mode[0] == 'r') { if (!files.count(p)) return r; r.f = files[p]; r.canWrite = strchr(mode, '+') != nullptr; }
+  else if (mode[0] == 'w') { auto m = std::make_shared<MemFile>(); files[p] = m; r.f = m; r.canWrite = true; }
+  else if (mode[0] == 'a') { if (!files.count(p)) files[p] = std::make_shared<MemFile>(); r.f = files[p]; r.pos = r.f->data.size(); r.canWrite = true; }
+  return r;
+}
+Dir FS::openDir(const char* p) { Dir d; d.prefix = p; return d; }
+bool FS::info(FSInfo& i) { memset(&i, 0, sizeof(i)); i.totalBytes = 1 << 20; for (auto& e : files) i.usedBytes += e.second->data.size(); return true; }
+bool Dir::next() { int i = 0; for (auto& e : files) { if (i > idx && e.first.compare(0, prefix.size(), prefix) == 0) { idx = i; return true; } i++; } idx = i; return false; }
+static std::map<std::string, std::shared_ptr<MemFile>>::iterator dirIt(int idx) { auto it = files.begin(); std::advance(it, idx); return it; }
+String Dir::fileName() { return String(dirIt(idx)->first); }
+size_t Dir::fileSize() { return dirIt(idx)->second->data.size(); }
+File Dir::openFile(const char* mode) { return SPIFFS.open(dirIt(idx)->first.c_str(), mode); }
+
+bool PubSubClient::beginPublish(const char*, unsigned int length, bool)
+{
+  streamLength = length;
+  streamWritten = 0;
+  return true;
+}
+
+size_t PubSubClient::write(const uint8_t*, size_t n)
+{
+  streamWritten += n;
+  return n;
+}
+
+int PubSubClient::endPublish()
+{
+  if (streamWritten != streamLength) return 0; // length announced in beginPublish must match
+  return 1;
+}
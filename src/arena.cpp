@@ -0,0 +1,31 @@
+#include "globals.h"
+
+/*
+ * Static memory arena
+ *
+ * All large buffers are parts of one statically allocated block, nothing of
+ * this size is placed on the stack (4 KB on ESP8266) or heap. Its size is
+ * checked at compile time against RAM budget ARENA_SIZE_MAX (16 KB) and
+ * listed by the RAM report after firmware build (tools/ram_report.py).
+ *
+ * Owners:
+ * - message   - MQTTcallback(), text of current message. Valid only during
+ *               route handler, handlers must not run MQTTloop().
+ * - irData    - (rawIrData) durations parsed from message or read from slot
+ *               database. Scratch buffer of current handler, slot cache
+ *               miss, receiver matcher and loadDefaultIR(); contents are
+ *               never kept between loop() iterations and any call that may
+ *               read slot database (getSlotData) overwrites it.
+ * - slotCache - slotcache.cpp, decoded slots.
+ * - txPool    - txqueue.cpp, RAW/GC codes waiting for transmission.
+ * - topics    - topics.cpp, fixed outbound topics.
+ * - rxRing    - rxcapture.cpp, receiver captures waiting for publishing.
+ *               Written from Ticker (rxCapturePoll) as well as loop().
+ */
+
+ArenaStruct arena;
+
+static_assert(sizeof(ArenaStruct) <= ARENA_SIZE_MAX, "Static buffers exceed ARENA_SIZE_MAX");
+static_assert(sizeof(arena.message) > MQTT_MAX_PACKET_SIZE - 5, "Message buffer smaller than MQTT packet");
+static_assert(sizeof(arena.slotCache) >= 2*(SLOT_SIZE+1), "Slot cache can't keep button slots");
+static_assert(TX_POOL_SIZE >= SLOT_SIZE+1, "Transmit pool can't keep the longest code");
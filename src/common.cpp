@@ -1,14 +1,14 @@
 #include "globals.h"
 
 /* **************************************************************
- * Convert String to unsigned long
+ * Convert String to unsigned 64-bit number
  */
-unsigned long StrToUL(String inputString)
+uint64_t StrToULL(const char *inputString)
 {
-  unsigned long result = 0;
-  for (int i = 0; i < inputString.length(); i++)
+  uint64_t result = 0;
+  for (int i = 0; inputString[i] != '\0'; i++)
   {
-    char c = inputString.charAt(i);
+    char c = inputString[i];
     if (c < '0' || c > '9') break;
     result *=10;
     result += (c - '0');
@@ -17,53 +17,405 @@ unsigned long StrToUL(String inputString)
 }
 
 /* **************************************************************
- * Write IR codes array to slot file
- * - fName - destination file
- * - sourceArray[] - source for data into slot
- * - sourceSize - number of elements in array
+ * Convert unsigned number to decimal string (without terminating null)
+ * - value - number to convert
+ * - buf - destination, at least 10 chars
+ * @returns number of chars
  */
-bool writeDataFile(const char* fName, uint16_t sourceArray[], int sourceSize)
+uint8_t uintToStr(uint32_t value, char *buf)
 {
-  if (SPIFFS.exists(fName))
+  char tmp[10];
+  uint8_t len = 0;
+  do
   {
-    sendToDebug("*IR: File exists - removeing\n");
-    SPIFFS.remove(fName);
-    sendToDebug("*IR: File remove\n");
+    tmp[len++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  for (uint8_t i=0;i<len;i++)
+    buf[i] = tmp[len-1-i];
+  return len;
+}
+
+/* **************************************************************
+ * Number of decimal digits of unsigned number
+ */
+uint8_t uintDigits(uint32_t value)
+{
+  uint8_t len = 1;
+  while (value >= 10)
+  {
+    value /= 10;
+    len++;
+  }
+  return len;
+}
+
+/* **************************************************************
+ * Convert 64 bit unsigned number to null terminated decimal string
+ * - buf - destination, at least 21 chars
+ */
+void uint64ToStr(uint64_t value, char *buf)
+{
+  if (value <= 0xFFFFFFFFUL)
+  {
+    buf[uintToStr(value, buf)] = '\0';
+    return;
+  }
+  char tmp[21];
+  uint8_t len = 0;
+  while (value)
+  {
+    tmp[len++] = '0' + value % 10;
+    value /= 10;
+  }
+  for (uint8_t i=0;i<len;i++)
+    buf[i] = tmp[len-1-i];
+  buf[len] = '\0';
+}
+
+/* **************************************************************
+ * Parse comma separated list of numbers directly from MQTT payload
+ * - payload - message content
+ * - length - message length
+ * - destinationArray[] - destination for parsed numbers
+ * - maxElements - size of destinationArray
+ * @returns
+ * - -1 - wrong format (not allowed char, empty element, value above 65535)
+ * - -2 - too many elements
+ * -  n - number of parsed elements
+ */
+int parseNumberList(const byte* payload, unsigned int length, uint16_t destinationArray[], int maxElements)
+{
+  int elementIdx = 0;
+  uint32_t value = 0;
+  bool hasDigit = false;
+  for (unsigned int i=0;i<=length;i++)
+  {
+    if (i==length || payload[i]==',')
+    {
+      // Coma at begin or end and empty elements are not allowed
+      if (!hasDigit)
+        return -1;
+      if (elementIdx>=maxElements)
+        return -2;
+      destinationArray[elementIdx++] = value;
+      value = 0;
+      hasDigit = false;
+    }
+    else if (payload[i]>='0' && payload[i]<='9')
+    {
+      value = value*10 + (payload[i]-'0');
+      if (value>0xFFFF)
+        return -1;
+      hasDigit = true;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  return elementIdx;
+}
+
+/* **************************************************************
+ * Check if string is number (slot or macro number, otherwise it is name)
+ */
+bool isNumber(const char *str)
+{
+  return str[0] != '\0' && strspn(str, "0123456789") == strlen(str);
+}
+
+/* **************************************************************
+ * FNV-1a hash of string
+ */
+uint32_t strHash(const char *str)
+{
+  uint32_t hash = 2166136261UL;
+  while (*str)
+  {
+    hash ^= (uint8_t) *str++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+/* **************************************************************
+ * Add duration to Fletcher-16 sums (bytes in little endian order)
+ */
+static void slotChecksumAdd(uint16_t &sum1, uint16_t &sum2, uint16_t value)
+{
+  sum1 = (sum1 + (value & 0xFF)) % 255;
+  sum2 = (sum2 + sum1) % 255;
+  sum1 = (sum1 + (value >> 8)) % 255;
+  sum2 = (sum2 + sum1) % 255;
+}
+
+/* **************************************************************
+ * Fletcher-16 checksum of slot body
+ * - data[] - durations
+ * - count - number of elements in array
+ */
+uint16_t slotChecksum(const uint16_t data[], int count)
+{
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (int i=0;i<count;i++)
+    slotChecksumAdd(sum1, sum2, data[i]);
+  return (sum2 << 8) | sum1;
+}
+
+/* **************************************************************
+ * Find symbol matching duration
+ * - seeds[] - first duration of every symbol
+ * @returns symbol index, -1 if not found
+ */
+static int slotFindSymbol(const uint16_t seeds[], int symbolsNo, uint16_t value)
+{
+  for (int i=0;i<symbolsNo;i++)
+  {
+    uint16_t tolerance = (uint32_t) seeds[i] * SLOT_PACK_TOLERANCE / 100;
+    if (tolerance < SLOT_PACK_MIN_TOLERANCE)
+      tolerance = SLOT_PACK_MIN_TOLERANCE;
+    if (abs((int32_t) value - seeds[i]) <= tolerance)
+      return i;
+  }
+  return -1;
+}
+
+/* **************************************************************
+ * Number of bits needed for symbol index
+ */
+static uint8_t slotSymbolBits(int symbolsNo)
+{
+  uint8_t bits = 1;
+  while ((1 << bits) < symbolsNo)
+    bits++;
+  return bits;
+}
+
+/* **************************************************************
+ * Size of packed body: symbols number, reserved byte, symbols table and
+ * bit packed symbol indexes
+ */
+static size_t slotPackedSize(int symbolsNo, uint16_t count)
+{
+  return 2 + symbolsNo*sizeof(uint16_t) + ((uint32_t) count*slotSymbolBits(symbolsNo)+7)/8;
+}
+
+/* **************************************************************
+ * Pack durations into symbols table and bit packed symbol indexes,
+ * durations are stored as values of their symbols
+ * - data[] - durations, count - number of durations
+ * - body - destination (SLOT_PACKED_MAX bytes)
+ * - checksum - set to slotChecksum() of stored durations
+ * @returns size of packed body, 0 if durations can't be packed
+ */
+static size_t packSlot(const uint16_t data[], uint16_t count, uint8_t *body, uint16_t *checksum)
+{
+  uint16_t seeds[SLOT_PACK_SYMBOLS];
+  uint32_t sums[SLOT_PACK_SYMBOLS];
+  uint16_t counts[SLOT_PACK_SYMBOLS];
+  int symbolsNo = 0;
+  for (uint16_t i=0;i<count;i++)
+  {
+    int symbol = slotFindSymbol(seeds, symbolsNo, data[i]);
+    if (symbol == -1)
+    {
+      if (symbolsNo == SLOT_PACK_SYMBOLS)
+        return 0;
+      symbol = symbolsNo++;
+      seeds[symbol] = data[i];
+      sums[symbol] = 0;
+      counts[symbol] = 0;
+    }
+    sums[symbol] += data[i];
+    counts[symbol]++;
+  }
+  uint8_t bits = slotSymbolBits(symbolsNo);
+  size_t bodySize = slotPackedSize(symbolsNo, count);
+  if (bodySize >= count*sizeof(uint16_t))
+    return 0;
+
+  body[0] = symbolsNo;
+  body[1] = 0;
+  uint16_t *symbols = (uint16_t *) &body[2];
+  for (int i=0;i<symbolsNo;i++)
+  {
+    symbols[i] = (sums[i] + counts[i]/2) / counts[i];
+  }
+  uint8_t *stream = &body[2 + symbolsNo*sizeof(uint16_t)];
+  memset(stream, 0, &body[bodySize] - stream);
+  uint32_t bitPos = 0;
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (uint16_t i=0;i<count;i++)
+  {
+    int symbol = slotFindSymbol(seeds, symbolsNo, data[i]);
+    slotChecksumAdd(sum1, sum2, symbols[symbol]);
+    for (uint8_t b=0;b<bits;b++,bitPos++)
+    {
+      if (symbol & (1 << b))
+        stream[bitPos/8] |= 1 << (bitPos%8);
+    }
+  }
+  *checksum = (sum2 << 8) | sum1;
+  return bodySize;
+}
+
+/* **************************************************************
+ * Expand packed body into durations
+ * - body - packed body, bodySize - its size
+ * - count - number of durations
+ * - destinationArray[] - destination for durations
+ * @returns false if body is broken
+ */
+static bool unpackSlot(const uint8_t *body, size_t bodySize, uint16_t count, uint16_t destinationArray[])
+{
+  int symbolsNo = body[0];
+  if (symbolsNo == 0 || symbolsNo > SLOT_PACK_SYMBOLS)
+    return false;
+  uint8_t bits = slotSymbolBits(symbolsNo);
+  if (bodySize < slotPackedSize(symbolsNo, count))
+    return false;
+  const uint16_t *symbols = (const uint16_t *) &body[2];
+  const uint8_t *stream = &body[2 + symbolsNo*sizeof(uint16_t)];
+  uint32_t bitPos = 0;
+  for (uint16_t i=0;i<count;i++)
+  {
+    int symbol = 0;
+    for (uint8_t b=0;b<bits;b++,bitPos++)
+    {
+      if (stream[bitPos/8] & (1 << (bitPos%8)))
+        symbol |= 1 << b;
+    }
+    if (symbol >= symbolsNo)
+      return false;
+    destinationArray[i] = symbols[symbol];
+  }
+  return true;
+}
+
+/* **************************************************************
+ * Encode IR codes array into slot header and body (binary format)
+ * - sourceArray[] - source for data into slot, last element is frequency
+ *   (not changed, packed slot keeps values of symbols)
+ * - sourceSize - number of elements in array (1..SLOT_SIZE+1)
+ * - header - destination for slot header
+ * - packed - buffer for packed body ((SLOT_PACKED_MAX+1)/2 elements)
+ * - body - set to body to store (packed or sourceArray)
+ * @returns size of body in bytes
+ */
+size_t encodeSlot(const uint16_t sourceArray[], int sourceSize, SlotHeaderStruct &header, uint16_t packed[], const uint8_t **body)
+{
+  header.magic = SLOT_MAGIC;
+  header.version = SLOT_VERSION;
+  header.flags = 0;
+  header.count = sourceSize-1;
+  header.freq = sourceArray[sourceSize-1];
+  *body = (const uint8_t *) sourceArray;
+  size_t bodySize = packSlot(sourceArray, header.count, (uint8_t *) packed, &header.checksum);
+  if (bodySize > 0)
+  {
+    header.flags |= SLOT_FLAG_PACKED;
+    *body = (const uint8_t *) packed;
+  }
+  else
+  {
+    bodySize = header.count*sizeof(uint16_t);
+    header.checksum = slotChecksum(sourceArray, header.count);
   }
-  File file = SPIFFS.open(fName, "w");
-  if (file)
+  return bodySize;
+}
+
+/* **************************************************************
+ * Decode slot body from file (positioned just after header)
+ * - header - slot header
+ * - file - source file
+ * - destinationArray[] - destination for data from slot (SLOT_SIZE+1 elements),
+ *   last element is frequency
+ * @returns
+ * - -3 - corrupted or unsupported slot
+ * -  n - number of elements in slot
+ */
+int decodeSlot(const SlotHeaderStruct &header, File &file, uint16_t destinationArray[])
+{
+  if (header.magic != SLOT_MAGIC || header.version < 1 || header.version > SLOT_VERSION || header.count > SLOT_SIZE)
+    return -3;
+  bool bodyOk;
+  if (header.flags & SLOT_FLAG_PACKED)
+  {
+    // Symbols number first, then exactly the rest of body
+    uint16_t packed[(SLOT_PACKED_MAX+1)/2];
+    uint8_t *body = (uint8_t *) packed;
+    bodyOk = file.read(body, 2) == 2 && body[0] > 0 && body[0] <= SLOT_PACK_SYMBOLS;
+    size_t bodySize = bodyOk ? slotPackedSize(body[0], header.count) : 0;
+    bodyOk = bodyOk && file.read(body+2, bodySize-2) == bodySize-2
+             && unpackSlot(body, bodySize, header.count, destinationArray);
+  }
+  else
   {
-    sendToDebug("*IR: Start writing to file: ");
-    for (int i=0;i<sourceSize;i++)
+    size_t bodySize = header.count*sizeof(uint16_t);
+    bodyOk = file.read((uint8_t *) destinationArray, bodySize) == bodySize;
+  }
+  if (!bodyOk || slotChecksum(destinationArray, header.count) != header.checksum)
+    return -3;
+  destinationArray[header.count] = header.freq;
+  return header.count+1;
+}
+
+/* **************************************************************
+ * Read IR codes from legacy text slot file (one number per line)
+ * - file - opened slot file
+ * - destinationArray[] - destination for data from slot
+ * @returns number of elements read
+ */
+static int readLegacyDataFile(File &file, uint16_t destinationArray[])
+{
+  char buf[64];
+  int i = 0;
+  unsigned long value = 0;
+  bool inNumber = false;
+  file.seek(0, SeekSet);
+  while (file.available())
+  {
+    size_t len = file.readBytes(buf, sizeof(buf));
+    for (size_t j=0;j<len;j++)
     {
-      if (i>0)
+      char c = buf[j];
+      if (c >= '0' && c <= '9')
       {
-        file.print("\n");
-        sendToDebug(",");
+        value = value*10 + (c - '0');
+        inNumber = true;
+      }
+      else if (c == '\n' && inNumber)
+      {
+        if (i>SLOT_SIZE) return i;
+        destinationArray[i++] = (uint16_t) value;
+        value = 0;
+        inNumber = false;
       }
-      sendToDebug(String(sourceArray[i]));
-      file.print(sourceArray[i]);
     }
-    sendToDebug("\n*IR: Writing ok");
-    file.close();
-    sendToDebug("*IR: Writing ok\n");
-    return true;
   }
-  else
+  if (inNumber && i<=SLOT_SIZE)
   {
-    return false;
+    destinationArray[i++] = (uint16_t) value;
   }
+  return i;
 }
+
 /* **************************************************************
- * Read IR codes array from slot file
+ * Read IR codes array from slot file of previous firmware (/ir/N.dat,
+ * text or binary format), used for migration to slot database
  * - fName - source file
- * - destinationArray[] - destination for data from slot
+ * - destinationArray[] - destination for data from slot (SLOT_SIZE+1 elements),
+ *   last element is frequency
  * @returns
  * - -1 - config file not exists
  * - -2 - problem with file opening
+ * - -3 - corrupted slot file
  * -  n - number of elements in store
  */
-uint16_t readDataFile(char * fName, uint16_t destinationArray[])
+int readDataFile(const char * fName, uint16_t destinationArray[])
 {
   if (!SPIFFS.exists(fName))
   {
@@ -78,23 +430,26 @@ uint16_t readDataFile(char * fName, uint16_t destinationArray[])
     return -2;
   }
 
-  size_t size = IRconfigFile.size();
-  if (size>2500)
+  SlotHeaderStruct header;
+  size_t headerSize = IRconfigFile.read((uint8_t *) &header, sizeof(header));
+  int result;
+  if (headerSize != sizeof(header) || header.magic != SLOT_MAGIC)
   {
-    sendToDebug(String("*IR: Config file ")+fName+" size ("+size+") is too large.\n");
+    sendToDebug(String("*IR: Reading text slot file: ")+fName+"\n");
+    result = readLegacyDataFile(IRconfigFile, destinationArray);
   }
-  int i =0;
-  sendToDebug(String("*IR: Start reading file: ")+fName+" size: "+size+"\n");
-  while(IRconfigFile.available() )
+  else
   {
-    String line = IRconfigFile.readStringUntil('\n');
-    destinationArray[i]=(unsigned int)line.toInt();
-    i++;
+    result = decodeSlot(header, IRconfigFile, destinationArray);
+    if (result<0)
+    {
+      sendToDebug(String("*IR: Corrupted slot file: ")+fName+"\n");
+    }
   }
-  return i;
+  IRconfigFile.close();
+  return result;
 }
 
-
 /**********************************************
  * Convert MAC to String
  */
@@ -120,40 +475,16 @@ void saveConfigCallback ()
 }
 
 /***************************************************
- * Load default IR data
+ * Load default IR data (pinned slots) into cache
  */
 
 void loadDefaultIR()
 {
   sendToDebug("*IR: loading IR raw codes\n");
-  char fName[20];
-  sprintf(fName,"/ir/1.dat");
-  rawIR1size = readDataFile(fName, rawIR1);
-  sprintf(fName,"/ir/2.dat");
-  rawIR2size = readDataFile(fName, rawIR2);
-}
-
-/***************************************************************
- *  Interpreter of IR encoding ID
- */
-void  getIrEncoding (decode_results *results, char * result_encoding)
-{
-  switch (results->decode_type)
+  uint16_t *data;
+  for (int slotNo=1;slotNo<=SLOT_CACHE_PINNED;slotNo++)
   {
-    default:
-    case UNKNOWN:      strncpy(result_encoding,"UNKNOWN\0",8);       break ;
-    case NEC:          strncpy(result_encoding,"NEC\0",4);           break ;
-    case SONY:         strncpy(result_encoding,"SONY\0",5);          break ;
-    case RC5:          strncpy(result_encoding,"RC5\0",4);           break ;
-    case RC6:          strncpy(result_encoding,"RC6\0",4);           break ;
-    case DISH:         strncpy(result_encoding,"DISH\0",5);          break ;
-    case SHARP:        strncpy(result_encoding,"SHARP\0",6);         break ;
-    case JVC:          strncpy(result_encoding,"JVC\0",4);           break ;
-    case SANYO:        strncpy(result_encoding,"SANYO\0",6);         break ;
-    case MITSUBISHI:   strncpy(result_encoding,"MITSUBISHI\0",11);   break ;
-    case SAMSUNG:      strncpy(result_encoding,"SAMSUNG\0",8);       break ;
-    case LG:           strncpy(result_encoding,"LG\0",3);            break ;
-    case WHYNTER:      strncpy(result_encoding,"WHYNTER\0",8);       break ;
-    case PANASONIC:    strncpy(result_encoding,"PANASONIC\0",11);    break ;
+    getSlotData(slotNo, &data);
   }
 }
+
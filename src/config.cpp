@@ -0,0 +1,205 @@
+#include "globals.h"
+
+/*
+ * Configuration
+ *
+ * /config.json (written by WiFiManager portal) is the source of settings.
+ * Its parsed values are kept in CONFIG_CACHE_FILE together with hash of
+ * JSON text, so JSON is parsed only when it changes. Cache keeps also
+ * parameters of last WiFi connection (BSSID, channel, IP settings) for
+ * fast reconnect after restart.
+ */
+
+static_assert(offsetof(ConfigCacheStruct, checksum) % 2 == 0, "ConfigCacheStruct checksum must be aligned");
+
+/* **************************************************************
+ * Read and validate config cache
+ * @returns false if cache is missing or broken
+ */
+bool readConfigCache(ConfigCacheStruct &cache)
+{
+  File file = SPIFFS.open(CONFIG_CACHE_FILE, "r");
+  if (!file)
+    return false;
+  bool result = file.read((uint8_t *) &cache, sizeof(cache)) == sizeof(cache);
+  file.close();
+  return result && cache.magic == CONFIG_CACHE_MAGIC && cache.version == CONFIG_CACHE_VERSION
+         && cache.checksum == slotChecksum((const uint16_t *) &cache, offsetof(ConfigCacheStruct, checksum)/2);
+}
+
+/* **************************************************************
+ * Write config cache
+ */
+static bool writeConfigCache(ConfigCacheStruct &cache)
+{
+  cache.magic = CONFIG_CACHE_MAGIC;
+  cache.version = CONFIG_CACHE_VERSION;
+  cache.checksum = slotChecksum((const uint16_t *) &cache, offsetof(ConfigCacheStruct, checksum)/2);
+  File file = SPIFFS.open(CONFIG_CACHE_FILE, "w");
+  if (!file)
+    return false;
+  bool result = file.write((const uint8_t *) &cache, sizeof(cache)) == sizeof(cache);
+  file.close();
+  return result;
+}
+
+/* **************************************************************
+ * Copy MQTT settings between cache and global variables
+ */
+static void configToCache(ConfigCacheStruct &cache)
+{
+  memcpy(cache.mqtt_server, mqtt_server, sizeof(cache.mqtt_server));
+  memcpy(cache.mqtt_port, mqtt_port, sizeof(cache.mqtt_port));
+  memcpy(cache.mqtt_user, mqtt_user, sizeof(cache.mqtt_user));
+  memcpy(cache.mqtt_pass, mqtt_pass, sizeof(cache.mqtt_pass));
+  memcpy(cache.mqtt_prefix, mqtt_prefix, sizeof(cache.mqtt_prefix));
+  memcpy(cache.mqtt_secure, mqtt_secure, sizeof(cache.mqtt_secure));
+}
+
+static void configFromCache(const ConfigCacheStruct &cache)
+{
+  memcpy(mqtt_server, cache.mqtt_server, sizeof(cache.mqtt_server));
+  memcpy(mqtt_port, cache.mqtt_port, sizeof(cache.mqtt_port));
+  memcpy(mqtt_user, cache.mqtt_user, sizeof(cache.mqtt_user));
+  memcpy(mqtt_pass, cache.mqtt_pass, sizeof(cache.mqtt_pass));
+  memcpy(mqtt_prefix, cache.mqtt_prefix, sizeof(cache.mqtt_prefix));
+  memcpy(mqtt_secure, cache.mqtt_secure, sizeof(cache.mqtt_secure));
+}
+
+/* **************************************************************
+ * Copy JSON string value into setting
+ */
+static void jsonToSetting(JsonObject &json, const char *key, char *setting, size_t size)
+{
+  if (json.containsKey(key))
+  {
+    strncpy(setting, json[key], size-1);
+    setting[size-1] = '\0';
+  }
+}
+
+/* **************************************************************
+ * Load MQTT settings - from cache when /config.json is not changed,
+ * otherwise from JSON (and cache is updated). Broken JSON leaves default
+ * settings - WiFi settings are not reset because of it.
+ * @returns false if there is no configuration file
+ */
+bool loadConfig()
+{
+  File configFile = SPIFFS.open("/config.json", "r");
+  if (!configFile)
+  {
+    sendToDebug("*IR: no config file\n");
+    return false;
+  }
+  size_t size = configFile.size();
+  // Allocate a buffer to store contents of the file.
+  std::unique_ptr<char[]> buf(new char[size+1]);
+  configFile.readBytes(buf.get(), size);
+  configFile.close();
+  buf[size] = '\0';
+  uint32_t jsonHash = strHash(buf.get());
+
+  ConfigCacheStruct cache;
+  bool cacheValid = readConfigCache(cache);
+  if (cacheValid && cache.jsonHash == jsonHash)
+  {
+    sendToDebug("*IR: config loaded from cache\n");
+    configFromCache(cache);
+    return true;
+  }
+
+  DynamicJsonBuffer jsonBuffer;
+  JsonObject& json = jsonBuffer.parseObject(buf.get());
+  if (!json.success())
+  {
+    sendToDebug("*IR: failed to load json config\n");
+    return true;
+  }
+  sendToDebug("*IR: parsed json\n");
+  jsonToSetting(json, "mqtt_server", mqtt_server, sizeof(mqtt_server));
+  jsonToSetting(json, "mqtt_port", mqtt_port, sizeof(mqtt_port));
+  jsonToSetting(json, "mqtt_secure", mqtt_secure, sizeof(mqtt_secure));
+  jsonToSetting(json, "mqtt_user", mqtt_user, sizeof(mqtt_user));
+  jsonToSetting(json, "mqtt_pass", mqtt_pass, sizeof(mqtt_pass));
+  jsonToSetting(json, "mqtt_prefix", mqtt_prefix, sizeof(mqtt_prefix));
+
+  if (!cacheValid)
+  {
+    memset(&cache, 0, sizeof(cache));
+  }
+  configToCache(cache);
+  cache.jsonHash = jsonHash;
+  writeConfigCache(cache);
+  return true;
+}
+
+/* **************************************************************
+ * Save MQTT settings into /config.json and cache
+ */
+void saveConfig()
+{
+  sendToDebug("*IR: saving config\n");
+  DynamicJsonBuffer jsonBuffer;
+  JsonObject& json = jsonBuffer.createObject();
+  json["mqtt_server"] = mqtt_server;
+  json["mqtt_user"] = mqtt_user;
+  json["mqtt_pass"] = mqtt_pass;
+  json["mqtt_prefix"] = mqtt_prefix;
+  json["mqtt_port"] = mqtt_port;
+  json["mqtt_secure"] = mqtt_secure;
+
+  size_t size = json.measureLength();
+  std::unique_ptr<char[]> tmpBuff(new char[size+1]);
+  size = json.printTo(tmpBuff.get(), size+1);
+  tmpBuff[size] = '\0';
+  File configFile = SPIFFS.open("/config.json", "w");
+  if (!configFile)
+  {
+    sendToDebug("*IR: failed to open config file for writing\n");
+    return;
+  }
+  configFile.write((const uint8_t *) tmpBuff.get(), size);
+  configFile.close();
+
+  ConfigCacheStruct cache;
+  memset(&cache, 0, sizeof(cache)); // WiFi could be changed too
+  configToCache(cache);
+  cache.jsonHash = strHash(tmpBuff.get());
+  writeConfigCache(cache);
+}
+
+/* **************************************************************
+ * Convert text settings (port, TLS flag)
+ */
+void applyConfig()
+{
+  mqtt_port_i = atoi(mqtt_port);
+  if (mqtt_port_i <= 0)
+    mqtt_port_i = DEFAULT_MQTT_PORT;
+  mqtt_secure_b = (mqtt_secure[0]=='1');
+}
+
+/* **************************************************************
+ * Store parameters of current WiFi connection for fast reconnect,
+ * cache file is written only when they change
+ */
+void updateWifiCache()
+{
+  ConfigCacheStruct cache;
+  if (!readConfigCache(cache))
+    return;
+  ConfigCacheStruct current = cache;
+  current.wifiValid = 1;
+  current.channel = WiFi.channel();
+  memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+  current.ip = WiFi.localIP();
+  current.gateway = WiFi.gatewayIP();
+  current.netmask = WiFi.subnetMask();
+  current.dns = WiFi.dnsIP();
+  if (memcmp(&current, &cache, sizeof(cache)) != 0)
+  {
+    sendToDebug("*IR: WiFi parameters cached\n");
+    writeConfigCache(current);
+  }
+}
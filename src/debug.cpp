@@ -1,10 +1,7 @@
 #include "globals.h"
 
 
-void sendToDebug(String message)
+void debugPrint(const String &message)
 {
-   if (useDebug)
-   {
-     Serial.print(message);
-   }
+   Serial.print(message);
 }
@@ -1,33 +1,27 @@
 #include "globals.h"
 
-uint16_t rawIrData[SLOT_SIZE+1];
-uint16_t rawSequence[SEQ_SIZE];
-
-uint16_t rawIR1[SLOT_SIZE+1];
-uint16_t rawIR2[SLOT_SIZE+1];
-
-uint16_t rawIR1size, rawIR2size;
+uint16_t (&rawIrData)[SLOT_SIZE+1] = arena.irData;
 
 char mqtt_server[40];
-char mqtt_port[5];
+char mqtt_port[6];
 char mqtt_user[32];
 char mqtt_pass[32];
 char mqtt_prefix[80];
-char mqtt_secure[1];
+char mqtt_secure[2];
 bool mqtt_secure_b;
 int mqtt_port_i;
 
 bool buttonState = 1 - BUTTON_ACTIVE_LEVEL; // State of control button
-bool MQTTMode = true;
 bool autoSendMode = false;
 bool shouldSaveConfig = false; //flag for saving data
 String clientName; // MQTT client name
 bool rawMode = false; // Raw mode receiver status
+bool rawBinary = false; // Raw mode receiver publishes compact binary format
 
 unsigned long lastTSAutoStart;
-unsigned long lastTSMQTTReconect;
 unsigned long autoStartFreq = 300000; // Frequency of autostart
 bool autoStartSecond = false;
+String bootInfo;
 
 #ifdef DEBUG
 const bool useDebug = true;
@@ -38,7 +32,7 @@ const bool useDebug = false;
 // ------------------------------------------------
 // Global objects
 
-IRrecv irrecv(RECV_PIN);
+IRrecv irrecv(RECV_PIN, RX_CAPTURE_SIZE);
 IRsend irsend(TRANS_PIN);
 
 WiFiClient wifiClient;
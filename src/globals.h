@@ -6,9 +6,94 @@
 #define GLOBALS_H
 
 // Slots for RAW data recording
-#define SLOTS_NUMBER 20 // Number of slots
-#define SLOT_SIZE 300   // Size of single slot
-#define SEQ_SIZE 10     // Raw sequnece size
+#define SLOTS_NUMBER 200 // Number of slots
+#define SLOT_SIZE 600   // Size of single slot (durations)
+
+// Decoded slots cache
+#define SLOT_CACHE_SIZE 3200   // RAM budget in bytes
+#define SLOT_CACHE_ENTRIES 20  // Max number of cached slots
+#define SLOT_CACHE_PINNED 2    // Slots 1..n (button/auto sender) are never evicted
+
+// Static memory arena (message, slot and transmit buffers)
+#define ARENA_MESSAGE_SIZE MQTT_MAX_PACKET_SIZE // Text of MQTT message
+#define ARENA_SIZE_MAX 16384                    // RAM budget of large buffers (bytes), checked at compile time
+
+// IR transmit queue
+#define TX_QUEUE_SIZE 16         // Max number of waiting frames
+#define TX_POOL_SIZE 640         // Buffer for RAW/GC codes from MQTT (elements), fits the longest code
+#define TX_FRAME_GAP 20          // Default gap between frames (ms)
+#define TX_DROP_OLDEST 0
+#define TX_REJECT 1
+#define TX_QUEUE_POLICY TX_DROP_OLDEST // Overflow policy
+#define TX_ADJUST_MAX 1000       // Max mark/space compensation (us)
+#define TX_CALIBRATION_MAGIC 0xC5
+
+// Macros
+#define MACROS_NUMBER 20          // Number of stored macros
+#define MACRO_STEPS 16            // Max steps of macro or slots sequence
+#define MACRO_DB_FILE "/ir/macros.db"
+#define MACRO_DB_MAGIC 0x434D5249 // "IRMC"
+#define MACRO_DB_VERSION 1
+
+// Receiver filter
+#define RX_REPEAT_WINDOW 200 // Identical frame within n ms after previous one is a repeat (ms)
+#define RX_RATE 4            // Messages per second per receiver topic
+#define RX_BURST 8           // Max messages at once per receiver topic
+#define RX_BUCKETS 8         // Number of rate limited topics
+#define RX_RING_SIZE 4       // Captures waiting for publishing (power of 2)
+#define RX_CAPTURE_SIZE 400  // Receiver buffer (durations + 1), library default RAWBUF (100) cuts A/C frames
+#define RX_POLL_PERIOD 10    // Receiver is polled from loop() at most every n ms
+#define RX_MATCH_TOLERANCE 25     // Unknown capture matches slot when durations differ at most n%
+#define RX_MATCH_MIN_TOLERANCE 100 // ...or at most n us
+#define RX_MATCH_MIN_LENGTH 8     // Captures shorter than n durations are not matched
+#define RX_MATCH_LONG 7           // Slot signature - duration is long when it is at least n/4 times the shortest one
+#define RX_MATCH_LENGTH_DIFF 2    // Capture and slot may differ by n trailing durations
+
+// Latency metrics
+#define METRICS_PERIOD 60000 // Publishing period of SUFFIX_METRICS (ms)
+#define METRIC_BUCKETS 24    // Histogram buckets (2^n us, last one collects longer durations)
+#define METRIC_ROUTE   0     // MQTT message arrival -> route resolved
+#define METRIC_HANDLER 1     // Route handler
+#define METRIC_SLOT    2     // Slot load
+#define METRIC_QUEUE   3     // Waiting in TX queue
+#define METRIC_TX      4     // Frame transmission
+#define METRIC_RX      5     // IR decode -> MQTT publish
+#define METRICS_NUMBER 6
+
+// Health telemetry
+#define HEALTH_PERIOD 60000     // Publishing period of SUFFIX_HEALTH (ms)
+#define HEALTH_RATE_PERIOD 1000 // Loop rate is measured over n ms
+
+// Binary slot file format
+#define SLOT_MAGIC 0x31535249 // "IRS1"
+#define SLOT_VERSION 2
+#define SLOT_FLAG_PACKED 0x01      // durations stored as symbols table + bit packed symbols
+#define SLOT_PACK_SYMBOLS 16       // Max number of distinct durations in packed slot
+#define SLOT_PACK_TOLERANCE 15     // Durations within n% are stored as one symbol
+#define SLOT_PACK_MIN_TOLERANCE 60 // ...but at least within n us
+#define SLOT_PACKED_MAX (2+2*SLOT_PACK_SYMBOLS+(SLOT_SIZE*4+7)/8) // Max size of packed body
+
+// Slot database
+#define SLOT_DB_FILE "/ir/slots.db"
+#define SLOT_DB_TMP_FILE "/ir/slots.tmp"
+#define SLOT_DB_OLD_FILE "/ir/slots.old"    // Database being replaced by compacted copy
+#define SLOT_DB_JOURNAL_FILE "/ir/slots.jnl"
+#define SLOT_DB_BACKUP_FILE "/ir/slots.bak" // Database from other firmware after slotsreset
+#define SLOT_DB_MAGIC 0x42445249  // "IRDB"
+#define SLOT_DB_VERSION 2        // 1 - index without matcher signatures
+#define SLOT_NAME_SIZE 26         // Max slot name length + 1
+#define SLOT_DB_GARBAGE 4096      // Compact database when overwritten records take n bytes
+#define SLOT_DB_JOURNAL_SIZE 8    // Index updates kept in journal before they are written into database
+#define SLOT_DB_CHECKPOINT_DELAY 2000 // Write journal into database after n ms without slot changes
+#define UPLOAD_FILE "/ir/upload.tmp" // Parts of chunked upload
+
+// Boot
+#define CONFIG_CACHE_FILE "/config.bin"
+#define CONFIG_CACHE_MAGIC 0x46435249 // "IRCF"
+#define CONFIG_CACHE_VERSION 1
+#define WIFI_FAST_TIMEOUT 3000    // Connect with cached BSSID/channel/IP within n ms, then normal connect
+#define BOOT_BUTTON_WINDOW 5000   // Button held within n ms after boot starts configuration portal
+#define BOOT_BUTTON_HOLD 1000     // ...when held for n ms
 
 //#define DEBUG X
 
@@ -26,7 +111,7 @@
  // production device - ESP01
 #define RECV_PIN 0    // D3 - GPIO0 - IR detector/demodulator
 #define TRANS_PIN 3   // RX - GPIO3 - IR LED trasmitter
-#define TRIGGER_PIN 2 // D4 - GPIO2 - trigger reset (press and hold after boot - 5 seconds)
+#define TRIGGER_PIN 2 // D4 - GPIO2 - trigger reset (press and hold within 5 seconds after boot)
 //#define LED_PIN 1      // D4 - GPIO2
 #define BUTTON_ACTIVE_LEVEL LOW
 #endif
@@ -46,8 +131,61 @@
 #define    SUFFIX_SENDSTOREDRAW "/sender/sendStoredRaw"
 #define  SUFFIX_SENDSTORERAWSEQ "/sender/sendStoredRawSequence"
 #define              SUFFIX_OTA "/sender/otaURL"
+#define         SUFFIX_STORERAW "/sender/storeRaw"
+#define    SUFFIX_STORERAW_PART "/sender/storeRaw/part"
+#define  SUFFIX_STORERAW_COMMIT "/sender/storeRaw/commit"
+#define         SUFFIX_SLOTNAME "/sender/slotName"
+#define       SUFFIX_STOREMACRO "/sender/storeMacro"
+#define        SUFFIX_SENDMACRO "/sender/sendMacro"
+#define            SUFFIX_BATCH "/sender/batch"
+#define           SUFFIX_SENDGC "/sender/sendGC"
+#define          SUFFIX_SENDRAW "/sender/sendRAW"
+#define         SUFFIX_SENDRAWB "/sender/sendRAWb"
+#define        SUFFIX_RAWFORMAT "/sender/rawFormat"
+#define    SUFFIX_RAWFORMAT_VAL "/sender/rawFormat/val"
+#define          SUFFIX_TXQUEUE "/info/txQueue"
+#define          SUFFIX_METRICS "/info/metrics"
+#define             SUFFIX_BOOT "/info/boot"
+#define           SUFFIX_HEALTH "/info/health"
+#define           SUFFIX_CLIENT "/info/client"
+#define               SUFFIX_IP "/info/ip"
+#define             SUFFIX_TYPE "/info/type"
+#define          SUFFIX_VERSION "/info/version"
+#define     SUFFIX_RECEIVER_RAW "/receiver/raw"
+#define    SUFFIX_RECEIVER_RAWB "/receiver/rawb"
+#define    SUFFIX_RECEIVER_SLOT "/receiver/slot/"
+
+// Outbound topics table (_mqtt_prefix_ + SUFFIX_*)
+#define TOPIC_SIZE 128           // Max topic length + 1
+#define RX_TOPICS 8              // Number of cached receiver topics
+#define TOPIC_WILL              0
+#define TOPIC_SUBSCRIBE         1
+#define TOPIC_CMD_RESULT        2
+#define TOPIC_RAWMODE_VAL       3
+#define TOPIC_RAWFORMAT_VAL     4
+#define TOPIC_AUTOSENDMODE_VAL  5
+#define TOPIC_TXQUEUE           6
+#define TOPIC_METRICS           7
+#define TOPIC_BOOT              8
+#define TOPIC_CLIENT            9
+#define TOPIC_IP               10
+#define TOPIC_TYPE             11
+#define TOPIC_VERSION          12
+#define TOPIC_RECEIVER_RAW     13
+#define TOPIC_RECEIVER_RAWB    14
+#define TOPIC_RECEIVER_SLOT    15 // followed by slot number
+#define TOPIC_HEALTH           16
+#define TOPICS_NUMBER          17
+
+// MQTT topic routing
+#define ROUTE_KEY_SIZE 48   // Max length of topic suffix without numeric elements
+#define ROUTE_MAX_ARGS 3    // Max number of numeric topic elements
+#define ROUTE_INDEX_SIZE 64 // Size of routes hash index (power of 2)
+#define PROTOCOL_INDEX_SIZE 64 // Size of protocol names hash index (power of 2)
 
 #define DEFAULT_MQTT_PORT 1883
+#define MQTT_RECONNECT_MIN 1000  // First reconnect delay (ms)
+#define MQTT_RECONNECT_MAX 60000 // Max reconnect delay (ms)
 // ----------------------------------------------------------------
 // Global includes
 #include <ESP8266WiFi.h>
@@ -63,38 +201,149 @@
 #include <WiFiManager.h>          // https://github.com/tzapu/WiFiManager WiFi Configuration Magic (id: 567)
 #include <ArduinoJson.h>          // https://github.com/bblanchon/ArduinoJson (id: 64)
 #include <EEPROM.h>
+#include <Ticker.h>
 #include <ESP8266httpUpdate.h>
 
 // Global variables
-extern uint16_t rawIrData[SLOT_SIZE+1]; // RAW data storage
-extern uint16_t rawSequence[SEQ_SIZE];
-extern uint16_t rawIR1[SLOT_SIZE+1];
-extern uint16_t rawIR2[SLOT_SIZE+1];
-extern uint16_t rawIR1size, rawIR2size;
+extern uint16_t (&rawIrData)[SLOT_SIZE+1]; // RAW data storage (arena.irData)
 extern char mqtt_server[40];
-extern char mqtt_port[5];
+extern char mqtt_port[6];
 extern char mqtt_user[32];
 extern char mqtt_pass[32];
 extern char mqtt_prefix[80];
-extern char mqtt_secure[1];
+extern char mqtt_secure[2];
 extern bool mqtt_secure_b;
 extern int mqtt_port_i;
 extern bool buttonState; // State of control button
 extern bool autoSendMode;
-extern bool MQTTMode;
 extern bool shouldSaveConfig ; //flag for saving data
 extern String clientName; // MQTT client name
 extern bool rawMode; // Raw mode receiver status
+extern bool rawBinary; // Raw mode receiver publishes compact binary format
 extern unsigned long lastTSAutoStart; // Last timestamp of auto sender
-extern unsigned long lastTSMQTTReconect; // Last timestamp of MQTT reconnect
 extern unsigned long autoStartFreq; // Frequency of autostart
 extern bool autoStartSecond;
 extern const bool useDebug;
+extern String bootInfo; // Boot report published on SUFFIX_BOOT
 
 // ------------------------------------------------
 // STRUCTURES
 struct EEpromDataStruct {
   bool autoSendMode;
+  uint8_t txCalibration; // TX_CALIBRATION_MAGIC - adjustments below are set
+  int16_t markAdjust;    // added to every mark of stored slots (us)
+  int16_t spaceAdjust;   // added to every space of stored slots (us)
+};
+// Slot file header, followed by count uint16_t durations or (SLOT_FLAG_PACKED):
+// uint8_t symbols number, uint8_t reserved, uint16_t symbols[], symbol indexes
+// packed with 1-4 bits per duration (LSB first)
+struct SlotHeaderStruct {
+  uint32_t magic;    // SLOT_MAGIC
+  uint8_t version;   // SLOT_VERSION
+  uint8_t flags;     // SLOT_FLAG_*
+  uint16_t count;    // number of durations (without frequency)
+  uint16_t freq;     // carrier frequency in kHz
+  uint16_t checksum; // Fletcher-16 of durations
+};
+// Slot database file: SlotDbHeaderStruct, index of SLOTS_NUMBER entries,
+// records (SlotHeaderStruct + body) appended in any order
+struct SlotDbHeaderStruct {
+  uint32_t magic;    // SLOT_DB_MAGIC
+  uint8_t version;   // SLOT_DB_VERSION
+  uint8_t reserved;
+  uint16_t slotsNo;  // number of index entries
+};
+struct SlotIndexStruct {
+  uint32_t offset;             // record position in file, 0 - empty slot
+  uint16_t size;               // record size in bytes
+  uint16_t sigCount;           // receiver matcher signature - number of durations
+  uint32_t sigHash;            // receiver matcher signature - hash (rxMatchSignature)
+  char name[SLOT_NAME_SIZE];   // slot name, "" - no name
+  uint8_t reserved[2];
+};
+// Index update in SLOT_DB_JOURNAL_FILE
+struct SlotJournalStruct {
+  SlotIndexStruct entry;
+  uint16_t slotNo;
+  uint16_t checksum;           // Fletcher-16 of entry and slotNo
+};
+
+// Parsed /config.json and last WiFi connection parameters (CONFIG_CACHE_FILE)
+struct ConfigCacheStruct {
+  uint32_t magic;        // CONFIG_CACHE_MAGIC
+  uint8_t version;       // CONFIG_CACHE_VERSION
+  uint8_t wifiValid;     // WiFi parameters below are set
+  uint8_t channel;
+  uint8_t reserved;
+  uint8_t bssid[6];
+  uint16_t reserved2;
+  uint32_t ip;           // static IP for fast reconnect (last DHCP lease)
+  uint32_t gateway;
+  uint32_t netmask;
+  uint32_t dns;
+  uint32_t jsonHash;     // strHash of /config.json text
+  char mqtt_server[40];
+  char mqtt_port[6];
+  char mqtt_user[32];
+  char mqtt_pass[32];
+  char mqtt_prefix[80];
+  char mqtt_secure[2];
+  uint16_t checksum;     // Fletcher-16 of all fields above
+};
+
+// Compiled macro, macro file: SlotDbHeaderStruct (magic MACRO_DB_MAGIC,
+// slotsNo - number of macros) followed by MACROS_NUMBER records
+struct MacroStepStruct {
+  uint16_t slotNo;
+  uint16_t gap;      // delay after every frame (ms)
+  uint8_t repeats;   // number of frames
+  uint8_t reserved;
+};
+struct MacroStruct {
+  char name[SLOT_NAME_SIZE];            // "" - no name
+  uint8_t stepsNo;                      // 0 - empty macro
+  uint8_t reserved;
+  MacroStepStruct steps[MACRO_STEPS];
+};
+
+// Protocol sender (value, bits)
+typedef void (*IRSendFunction)(uint64_t value, uint16_t bits);
+// Protocol registry entry
+struct IRProtocolStruct {
+  const char *name;
+  decode_type_t type;
+  IRSendFunction sendFunction; // NULL - protocol can't be sent
+  uint16_t bits;               // default number of bits
+};
+// Parsed MQTT message passed to route handler
+struct MQTTRequestStruct {
+  byte *payload;             // raw message
+  unsigned int length;       // message length
+  const char *msg;           // message as null terminated string
+  const char *name;          // last non numeric topic element (e.g. IR type)
+  long args[ROUTE_MAX_ARGS]; // numeric topic elements (e.g. slot, bits)
+  uint8_t argsNo;
+};
+typedef void (*MQTTRouteHandler)(MQTTRequestStruct &req);
+struct MQTTRouteStruct {
+  const char *suffix;
+  MQTTRouteHandler handler;
+};
+// Entry of receiver capture ring (rxcapture.cpp)
+struct RxCaptureStruct {
+  decode_results results;
+  unsigned long captured;      // millis()
+  unsigned long capturedUs;    // micros()
+  uint16_t rawbuf[RX_CAPTURE_SIZE]; // durations of unknown codes
+};
+// Large static buffers, see arena.cpp for owners
+struct ArenaStruct {
+  char message[ARENA_MESSAGE_SIZE];
+  uint16_t irData[SLOT_SIZE+1];
+  uint16_t slotCache[SLOT_CACHE_SIZE/sizeof(uint16_t)];
+  uint16_t txPool[TX_POOL_SIZE];
+  char topics[TOPICS_NUMBER][TOPIC_SIZE];
+  RxCaptureStruct rxRing[RX_RING_SIZE];
 };
 // ------------------------------------------------
 // Global objects
@@ -105,20 +354,102 @@ struct EEpromDataStruct {
  extern WiFiClientSecure wifiClientSecure;
  extern PubSubClient mqttClient;
  extern EEpromDataStruct EEpromData;
+ extern ArenaStruct arena;
 // ------------------------------------------------
 // Functions declaration
-unsigned long StrToUL(String inputString);
-bool writeDataFile(const char* fName, uint16_t sourceArray[], int sourceSize);
-uint16_t readDataFile(char * fName, uint16_t destinationArray[]);
+uint64_t StrToULL(const char *inputString);
+bool isNumber(const char *str);
+uint32_t strHash(const char *str);
+size_t encodeSlot(const uint16_t sourceArray[], int sourceSize, SlotHeaderStruct &header, uint16_t packed[], const uint8_t **body);
+int decodeSlot(const SlotHeaderStruct &header, File &file, uint16_t destinationArray[]);
+int readDataFile(const char * fName, uint16_t destinationArray[]);
+int slotDbRead(int slotNo, uint16_t destinationArray[]);
+bool slotDbWrite(int slotNo, const uint16_t sourceArray[], int sourceSize);
+bool slotDbSetName(int slotNo, const char *name);
+int slotDbFind(const char *name);
+String slotDbInfo();
+bool slotDbBegin();
+bool slotDbReset();
+void slotDbLoop();
+String uploadPart(int slotNo, int partNo, const byte *payload, unsigned int length);
+String uploadCommit(int slotNo, const char *msg);
+int macroCompile(const char *msg, MacroStruct &macro);
+bool macroStore(int macroNo, const MacroStruct &macro);
+bool macroLoad(int macroNo, MacroStruct &macro);
+int macroFind(const char *name);
+bool macroPlay(const MacroStruct &macro);
+String macroInfo();
+uint8_t uintToStr(uint32_t value, char *buf);
+uint8_t uintDigits(uint32_t value);
+void uint64ToStr(uint64_t value, char *buf);
+int parseNumberList(const byte* payload, unsigned int length, uint16_t destinationArray[], int maxElements);
+uint16_t slotChecksum(const uint16_t data[], int count);
 String macToStr(const uint8_t* mac);
 void saveConfigCallback ();
+bool loadConfig();
+void saveConfig();
+void applyConfig();
+bool readConfigCache(ConfigCacheStruct &cache);
+void updateWifiCache();
 void loadDefaultIR();
-void connect_to_MQTT();
-void  getIrEncoding (decode_results *results, char * result_encoding);
+int getSlotData(int slotNo, uint16_t **data);
+void slotCacheInvalidate(int slotNo);
+void slotCacheUpdate(int slotNo);
+void slotCacheClear();
+bool sendStoredSlot(int slotNo);
+String slotCacheInfo();
+bool txQueueAddSlot(int slotNo, uint16_t gap, uint8_t repeats);
+bool txQueueHasSlot(int slotNo);
+bool txQueueAddRaw(const uint16_t data[], uint16_t size, uint16_t freq, uint16_t gap, uint8_t repeats);
+bool txQueueAddGC(const uint16_t data[], uint16_t size, uint16_t gap);
+bool txQueueAddCode(IRSendFunction sendFunction, uint64_t value, uint16_t bits, uint16_t gap);
+void txQueueGroupBegin();
+bool txQueueGroupEnd(bool commit);
+int txQueueDepth();
+String txQueueInfo();
+int16_t txAdjustment(int idx);
+void txProgramCompile(uint16_t durations[], int count);
+void txProgramEmit(const uint16_t program[], uint16_t count, uint16_t freq);
+void txProgramCarrierReset();
+String txCalibrate(const char *msg);
+void txQueueRun();
+void rxCapturePoll();
+void rxCaptureBegin();
+void rxCaptureLoop();
+String rxCaptureInfo();
+bool rxFilterCode(const decode_results *results, const char *topic, unsigned long now);
+void rxFilterLoop();
+bool rxRateAllow(const char *topic);
+String rxFilterInfo();
+int rxMatchSlot(const volatile uint16_t *rawbuf, uint16_t rawlen);
+void rxMatchSignature(const uint16_t durations[], int count, uint16_t &sigCount, uint32_t &sigHash);
+void rxMatchSetSignature(int slotNo, uint16_t sigCount, uint32_t sigHash);
+String rxMatchInfo();
+void topicsBuild();
+const char *getTopic(uint8_t id);
+const char *getReceiverTopic(decode_results *results);
+const char *getSlotTopic(int slotNo);
+void metricAdd(uint8_t metric, unsigned long duration);
+String metricsInfo();
+void metricsLoop();
+void healthSample();
+String healthInfo();
+void healthLoop();
+const IRProtocolStruct &irProtocol(decode_type_t type);
+const IRProtocolStruct *irProtocolFind(const char *name);
 
 void MQTTcallback(char* topic, byte* payload, unsigned int length);
-void connect_to_MQTT();
+unsigned int rawBinaryLength(const volatile uint16_t *rawbuf, uint16_t rawlen, uint16_t freq);
+void writeRawBinary(Print &out, const volatile uint16_t *rawbuf, uint16_t rawlen, uint16_t freq);
+int decodeRawBinary(const byte* payload, unsigned int length, uint16_t destinationArray[], int maxElements, uint16_t *freq);
+bool publishRawBinary(const char *topic, const volatile uint16_t *rawbuf, uint16_t rawlen);
+bool publishRawDurations(const char *topic, const volatile uint16_t *rawbuf, uint16_t rawlen);
+void MQTTsetup();
+bool connect_to_MQTT();
+void MQTTloop();
 void loadDefaultIR();
-void sendToDebug(String message);
+void debugPrint(const String &message);
+// Message is built only when debug is enabled (no String allocations otherwise)
+#define sendToDebug(message) do { if (useDebug) debugPrint(message); } while (0)
 
 #endif
@@ -0,0 +1,79 @@
+#include "globals.h"
+
+/*
+ * Health telemetry
+ *
+ * Heap is sampled once per loop() iteration (after MQTT handlers and
+ * transmit queue ran) and when summary is built.
+ * Stack high-water mark is reported by core (free stack never used since
+ * boot). Summary is returned by "sysinfo" command and published retained
+ * on SUFFIX_HEALTH every HEALTH_PERIOD.
+ */
+
+static uint32_t minFreeHeap = 0xFFFFFFFF;
+static unsigned long loopCount = 0;
+static unsigned long loopRate = 0;        // iterations per second in last HEALTH_RATE_PERIOD
+static unsigned long lastRateSample = 0;
+static unsigned long lastHealthPublish = 0;
+static unsigned long lastUptimeSample = 0;
+static uint64_t uptime = 0;               // ms, doesn't wrap like millis()
+
+/* **************************************************************
+ * Record heap usage
+ */
+void healthSample()
+{
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < minFreeHeap)
+    minFreeHeap = freeHeap;
+}
+
+/* **************************************************************
+ * Health summary for cmd topic and SUFFIX_HEALTH
+ */
+String healthInfo()
+{
+  healthSample();
+  String result = "Free heap=";
+  result += ESP.getFreeHeap();
+  result += ";Min free heap=";
+  result += minFreeHeap;
+  result += ";Max free block=";
+  result += ESP.getMaxFreeBlockSize();
+  result += ";Fragmentation=";
+  result += ESP.getHeapFragmentation();
+  result += "%;Free stack=";
+  result += ESP.getFreeContStack();
+  result += ";Loop rate=";
+  result += loopRate;
+  result += ";Uptime=";
+  result += (unsigned long) (uptime / 1000);
+  result += ";Reset reason=";
+  result += ESP.getResetReason();
+  return result;
+}
+
+/* **************************************************************
+ * Count loop iterations, periodic publishing, called from loop()
+ */
+void healthLoop()
+{
+  unsigned long now = millis();
+  loopCount++;
+  healthSample();
+  uptime += now - lastUptimeSample;
+  lastUptimeSample = now;
+  if (now - lastRateSample >= HEALTH_RATE_PERIOD)
+  {
+    loopRate = loopCount * 1000UL / (now - lastRateSample);
+    loopCount = 0;
+    lastRateSample = now;
+  }
+  if (now - lastHealthPublish < HEALTH_PERIOD)
+    return;
+  lastHealthPublish = now;
+  if (mqttClient.connected())
+  {
+    mqttClient.publish(getTopic(TOPIC_HEALTH), healthInfo().c_str(), true);
+  }
+}
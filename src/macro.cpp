@@ -0,0 +1,261 @@
+#include "globals.h"
+
+/*
+ * Macros - sequences of stored slots
+ *
+ * Macro text "[name=]step(,step)*", where step is "slot[*repeats][@gap]"
+ * (slot number or slot name, number of frames, delay after every frame in
+ * ms), is compiled on store into MacroStruct with resolved slot numbers and
+ * kept in MACRO_DB_FILE (header + MACROS_NUMBER fixed size records).
+ * On playback every step is queued as one TX job referring to transmit
+ * program of its slot, which is compiled into slot cache before the first
+ * frame is sent and stays there until the step is sent. While slots of
+ * macro fit into SLOT_CACHE_SIZE there is no file access between frames and
+ * frames are separated exactly by their gaps, other slots are read when
+ * their step is sent.
+ */
+
+#define MACRO_DB_SIZE (sizeof(SlotDbHeaderStruct) + MACROS_NUMBER*sizeof(MacroStruct))
+
+static_assert(TX_QUEUE_SIZE >= MACRO_STEPS, "Macro doesn't fit into TX queue");
+static_assert(SLOT_CACHE_ENTRIES >= SLOT_CACHE_PINNED + MACRO_STEPS, "Slot cache can't keep steps of macro");
+
+/* **************************************************************
+ * Open macro file, create it if it is missing or broken
+ */
+static File macroDbOpen()
+{
+  SlotDbHeaderStruct header;
+  File file = SPIFFS.open(MACRO_DB_FILE, "r+");
+  if (file && file.read((uint8_t *) &header, sizeof(header)) == sizeof(header)
+      && header.magic == MACRO_DB_MAGIC && header.version == MACRO_DB_VERSION
+      && header.slotsNo == MACROS_NUMBER && file.size() == MACRO_DB_SIZE)
+  {
+    return file;
+  }
+  if (file)
+    file.close();
+  sendToDebug("*IR: Creating macro file\n");
+  file = SPIFFS.open(MACRO_DB_FILE, "w");
+  if (!file)
+    return file;
+  header.magic = MACRO_DB_MAGIC;
+  header.version = MACRO_DB_VERSION;
+  header.reserved = 0;
+  header.slotsNo = MACROS_NUMBER;
+  bool result = file.write((const uint8_t *) &header, sizeof(header)) == sizeof(header);
+  MacroStruct macro;
+  memset(&macro, 0, sizeof(macro));
+  for (int i=0;i<MACROS_NUMBER && result;i++)
+  {
+    result = file.write((const uint8_t *) &macro, sizeof(macro)) == sizeof(macro);
+  }
+  file.close();
+  if (!result)
+    return File();
+  return SPIFFS.open(MACRO_DB_FILE, "r+");
+}
+
+/* **************************************************************
+ * Parse number
+ * @returns pointer after number, NULL if there is no number or it is
+ * bigger than maxValue
+ */
+static const char *macroParseNumber(const char *str, uint32_t maxValue, uint32_t *value)
+{
+  *value = 0;
+  const char *start = str;
+  while (*str >= '0' && *str <= '9')
+  {
+    *value = *value*10 + (*str++ - '0');
+    if (*value > maxValue)
+      return NULL;
+  }
+  return str == start ? NULL : str;
+}
+
+/* **************************************************************
+ * Compile macro text
+ * - msg - macro text "[name=]step(,step)*", step: "slot[*repeats][@gap]"
+ * - macro - destination
+ * @returns
+ * - -1 - wrong format
+ * - -2 - too many steps
+ * - -3 - slot is empty or unknown
+ * -  n - number of steps
+ */
+int macroCompile(const char *msg, MacroStruct &macro)
+{
+  memset(&macro, 0, sizeof(macro));
+  const char *equal = strchr(msg, '=');
+  if (equal != NULL)
+  {
+    if (equal-msg >= SLOT_NAME_SIZE)
+      return -1;
+    memcpy(macro.name, msg, equal-msg);
+    // Name can't be numeric (macro is played by number or name)
+    if (macro.name[0] == '\0' || isNumber(macro.name))
+      return -1;
+    msg = equal+1;
+  }
+  while (true)
+  {
+    if (macro.stepsNo >= MACRO_STEPS)
+      return -2;
+    MacroStepStruct &step = macro.steps[macro.stepsNo];
+    char slotName[SLOT_NAME_SIZE];
+    size_t nameLen = strcspn(msg, "*@,");
+    if (nameLen == 0 || nameLen >= SLOT_NAME_SIZE)
+      return -1;
+    memcpy(slotName, msg, nameLen);
+    slotName[nameLen] = '\0';
+    msg += nameLen;
+    if (isNumber(slotName))
+      step.slotNo = atoi(slotName);
+    else
+    {
+      int slotNo = slotDbFind(slotName);
+      step.slotNo = slotNo > 0 ? slotNo : 0;
+    }
+    uint16_t *data;
+    if (step.slotNo < 1 || step.slotNo > SLOTS_NUMBER || getSlotData(step.slotNo, &data) < 2)
+    {
+      sendToDebug(String("*IR: Macro slot is empty: ")+slotName+"\n");
+      return -3;
+    }
+    step.repeats = 1;
+    step.gap = TX_FRAME_GAP;
+    uint32_t value;
+    while (*msg == '*' || *msg == '@')
+    {
+      bool repeats = (*msg == '*');
+      msg = macroParseNumber(msg+1, repeats ? 255 : 0xFFFF, &value);
+      if (msg == NULL || (repeats && value == 0))
+        return -1;
+      if (repeats)
+        step.repeats = value;
+      else
+        step.gap = value;
+    }
+    macro.stepsNo++;
+    if (*msg == '\0')
+      return macro.stepsNo;
+    if (*msg++ != ',')
+      return -1;
+  }
+}
+
+/* **************************************************************
+ * Store compiled macro, macro without steps clears record
+ */
+bool macroStore(int macroNo, const MacroStruct &macro)
+{
+  if (macroNo<1 || macroNo>MACROS_NUMBER)
+    return false;
+  File file = macroDbOpen();
+  if (!file)
+    return false;
+  bool result = file.seek(sizeof(SlotDbHeaderStruct) + (macroNo-1)*sizeof(MacroStruct), SeekSet)
+                && file.write((const uint8_t *) &macro, sizeof(macro)) == sizeof(macro);
+  file.close();
+  return result;
+}
+
+/* **************************************************************
+ * Load compiled macro
+ * @returns false if macro is empty
+ */
+bool macroLoad(int macroNo, MacroStruct &macro)
+{
+  if (macroNo<1 || macroNo>MACROS_NUMBER)
+    return false;
+  File file = macroDbOpen();
+  if (!file)
+    return false;
+  bool result = file.seek(sizeof(SlotDbHeaderStruct) + (macroNo-1)*sizeof(MacroStruct), SeekSet)
+                && file.read((uint8_t *) &macro, sizeof(macro)) == sizeof(macro);
+  file.close();
+  macro.name[SLOT_NAME_SIZE-1] = '\0';
+  return result && macro.stepsNo > 0 && macro.stepsNo <= MACRO_STEPS;
+}
+
+/* **************************************************************
+ * Find macro by name
+ * @returns macro number, -1 if there is no macro with given name
+ */
+int macroFind(const char *name)
+{
+  File file = macroDbOpen();
+  if (!file || name[0] == '\0')
+    return -1;
+  MacroStruct macro;
+  file.seek(sizeof(SlotDbHeaderStruct), SeekSet);
+  for (int macroNo=1;macroNo<=MACROS_NUMBER;macroNo++)
+  {
+    if (file.read((uint8_t *) &macro, sizeof(macro)) != sizeof(macro))
+      break;
+    if (macro.stepsNo > 0 && strncmp(macro.name, name, SLOT_NAME_SIZE) == 0)
+      return macroNo;
+  }
+  return -1;
+}
+
+/* **************************************************************
+ * Queue all frames of macro
+ * @returns false if macro doesn't fit into TX queue or slot is empty,
+ * nothing is queued then
+ */
+bool macroPlay(const MacroStruct &macro)
+{
+  bool result = true;
+  txQueueGroupBegin();
+  for (uint8_t i=0;i<macro.stepsNo && result;i++)
+  {
+    const MacroStepStruct &step = macro.steps[i];
+    uint16_t *data;
+    result = getSlotData(step.slotNo, &data) >= 2 && txQueueAddSlot(step.slotNo, step.gap, step.repeats);
+  }
+  return txQueueGroupEnd(result);
+}
+
+/* **************************************************************
+ * Stored macros for cmd topic: macro[:name]=steps;...
+ */
+String macroInfo()
+{
+  File file = macroDbOpen();
+  if (!file)
+    return "Macro file error";
+  String result;
+  MacroStruct macro;
+  file.seek(sizeof(SlotDbHeaderStruct), SeekSet);
+  for (int macroNo=1;macroNo<=MACROS_NUMBER;macroNo++)
+  {
+    if (file.read((uint8_t *) &macro, sizeof(macro)) != sizeof(macro))
+      break;
+    if (macro.stepsNo == 0)
+      continue;
+    macro.name[SLOT_NAME_SIZE-1] = '\0';
+    result += macroNo;
+    if (macro.name[0])
+    {
+      result += ":";
+      result += macro.name;
+    }
+    result += "=";
+    for (uint8_t i=0;i<macro.stepsNo && i<MACRO_STEPS;i++)
+    {
+      if (i > 0)
+        result += ",";
+      result += macro.steps[i].slotNo;
+      result += "*";
+      result += macro.steps[i].repeats;
+      result += "@";
+      result += macro.steps[i].gap;
+    }
+    result += ";";
+  }
+  result += "Macros=";
+  result += MACROS_NUMBER;
+  return result;
+}
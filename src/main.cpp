@@ -11,11 +11,23 @@
  * broker -> module:
  *    "_mqtt_prefix_/sender/storeRaw/_store_id_"    msg: "\d+(,\d+)*"
  *                - store raw code in given slot _store_id_
- *    "_mqtt_prefix_/sender/sendStoredRaw"   msg: "\d+"
- *                - transmit raw code from given slot
- *    "_mqtt_prefix_/sender/sendStoredRawSequence"   msg: "\d(,\d+)*"
- *                - transmit raw codes seqnece of given slots
- *    "_mqtt_prefix_/sender/cmd"             msg: "(ls|sysinfo)"
+ *    "_mqtt_prefix_/sender/storeRaw/_store_id_/part/_n_"    msg: "\d+(,\d+)*"
+ *                - part _n_ (from 0) of long raw code
+ *    "_mqtt_prefix_/sender/storeRaw/_store_id_/commit"    msg: "count,checksum[,frequency]"
+ *                - store uploaded parts in given slot _store_id_
+ *    "_mqtt_prefix_/sender/slotName/_store_id_"    msg: ".*"
+ *                - set name of slot _store_id_
+ *    "_mqtt_prefix_/sender/sendStoredRaw"   msg: "\d+|.+"
+ *                - transmit raw code from given slot (number or name)
+ *    "_mqtt_prefix_/sender/sendStoredRawSequence"   msg: "step(,step)*"
+ *                - transmit raw codes seqnece of given slots, step: "slot[*repeats][@gap]"
+ *    "_mqtt_prefix_/sender/storeMacro/_macro_id_"  msg: "[name=]step(,step)*"
+ *                - compile and store macro
+ *    "_mqtt_prefix_/sender/sendMacro"       msg: "\d+|.+"
+ *                - transmit macro (number or name)
+ *    "_mqtt_prefix_/sender/batch"           msg: JSON array of actions
+ *                - queue many actions, summary in "_mqtt_prefix_/sender/cmd/result"
+ *    "_mqtt_prefix_/sender/cmd"             msg: "(ls|sysinfo|cache|txqueue|metrics|slots|receiver|macros)"
  *                - send system info query response in "esp8266/02/sender/cmd/result"
  *    "_mqtt_prefix_/sender/NC/HDMI"         msg: ".+"
  *                - send NC+ HDMI sequence
@@ -24,7 +36,7 @@
  *    "_mqtt_prefix_/sender/rawMode"         msg: "(1|ON|true|.*)"
  *                - enable/disable raw mode
  *    "_mqtt_prefix_/sender/type(/\d+(/\d+)) msg: "\d+"
- *                - esp8266/02/sender/type[/bits[/panasonic_address]] - type: NEC, RC_5, RC_6, SAMSUNG, SONY
+ *                - esp8266/02/sender/type[/bits[/panasonic_address]] - type: any protocol of IRremoteESP8266 with single value sender
  *    "_mqtt_prefix_/wipe" msg: ".*"
  *                - wpie config file
  *
@@ -33,6 +45,12 @@
  *                - recived message with given type and n-bits
  *    "_mqtt_prefix_/receiver/_type_/_bits_/_panas_addr_"  msg: "\d+"
  *                - recived message with given type and n-bits  and panasonic addres
+ *    "_mqtt_prefix_/receiver/_type_/_bits_[/_panas_addr_]/repeat"  msg: "Value=\d+;Repeats=\d+;Hold=\d+"
+ *                - button with given code was held, number of coalesced repeats and hold time (ms)
+ *    "_mqtt_prefix_/receiver/slot/_store_id_"  msg: "\d+"
+ *                - recived unknown code matching code stored in slot _store_id_
+ *    "_mqtt_prefix_/info/boot"  msg: "Config=\d+;WiFi=\d+;Fast=(0|1);MQTT=\d+"
+ *                - boot times (ms since power up), Fast=1 - WiFi connected with cached parameters
  *
  */
 
@@ -40,86 +58,39 @@
 #include "globals.h"
 
 /***************************************************
- * Setup
+ * Connect to last used access point with cached BSSID, channel and IP
+ * settings (no scan, no DHCP)
+ * @returns false if there are no cached parameters or connection failed
  */
-void setup(void)
+static bool fastWifiConnect()
 {
-
-  #ifdef DEBUG
-    Serial.begin(CUST_SERIAL_SPEED);
-  #else
-    Serial.begin(CUST_SERIAL_SPEED,SERIAL_8N1,SERIAL_TX_ONLY);
-    sendToDebug("*IR: non debug init\n");
-  #endif
-
-  // delay for reset button
-  delay(5000);
-
-  // Init EEPROM
-  EEPROM.begin(sizeof(EEpromData));
-  EEPROM.get(0,EEpromData);
-  if (EEpromData.autoSendMode!=true && EEpromData.autoSendMode!=false)
+  ConfigCacheStruct cache;
+  if (!readConfigCache(cache) || !cache.wifiValid || WiFi.SSID().length() == 0)
+    return false;
+  WiFi.mode(WIFI_STA);
+  WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.netmask), IPAddress(cache.dns));
+  WiFi.begin(WiFi.SSID().c_str(), WiFi.psk().c_str(), cache.channel, cache.bssid);
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED)
   {
-    EEpromData.autoSendMode=false;
-    EEPROM.put(0, EEpromData);
-    EEPROM.commit();
-  }
-
-  pinMode(TRIGGER_PIN, INPUT);
-
-  #ifdef LED_PIN
-  pinMode(LED_PIN,OUTPUT);
-  #endif
-  if (SPIFFS.begin())
-  {
-    sendToDebug("*IR: mounted file system\n");
-    if (SPIFFS.exists("/config.json"))
+    if (millis() - start > WIFI_FAST_TIMEOUT)
     {
-      //file exists, reading and loading
-      sendToDebug("*IR: reading config file\n");
-      File configFile = SPIFFS.open("/config.json", "r");
-      if (configFile)
-      {
-        sendToDebug("*IR: opened config file\n");
-        size_t size = configFile.size();
-        // Allocate a buffer to store contents of the file.
-        std::unique_ptr<char[]> buf(new char[size]);
-
-        configFile.readBytes(buf.get(), size);
-        DynamicJsonBuffer jsonBuffer;
-        JsonObject& json = jsonBuffer.parseObject(buf.get());
-        char tmpBuff[400];
-        json.printTo(tmpBuff, sizeof(tmpBuff));
-        sendToDebug(String("*IR: config: "+String(tmpBuff) + "\n"));
-        if (json.success())
-        {
-          sendToDebug("*IR: parsed json\n");
-          if (json.containsKey("mqtt_server"))
-            strcpy(mqtt_server, json["mqtt_server"]);
-          if (json.containsKey("mqtt_port"))
-            strcpy(mqtt_port, json["mqtt_port"]);
-          if (json.containsKey("mqtt_secure"))
-            strcpy(mqtt_secure, json["mqtt_secure"]);
-          if (json.containsKey("mqtt_user"))
-            strcpy(mqtt_user, json["mqtt_user"]);
-          if (json.containsKey("mqtt_pass"))
-            strcpy(mqtt_pass, json["mqtt_pass"]);
-          if (json.containsKey("mqtt_prefix"))
-            strcpy(mqtt_prefix, json["mqtt_prefix"]);
-        }
-        else
-        {
-          sendToDebug("*IR: failed to load json config\n");
-        }
-      }
+      // Access point or network changed - back to DHCP
+      sendToDebug("*IR: fast WiFi connect failed\n");
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());
+      return false;
     }
+    delay(10);
   }
-  else
-  {
-    sendToDebug("*IR: failed to mount FS\n");
-  }
-  sendToDebug("*IR: Start setup\n");
+  return true;
+}
 
+/***************************************************
+ * Connect to WiFi with WiFiManager, configuration portal is started if
+ * connection fails or force is set
+ */
+static void runConfigPortal(bool force)
+{
   WiFiManagerParameter custom_mqtt_secure("secure", "is secure server 0-no / 1-yes", mqtt_secure, 2);
   WiFiManagerParameter custom_mqtt_server("server", "MQTT server address", mqtt_server, 40);
   WiFiManagerParameter custom_mqtt_port("port", "MQTT server port", mqtt_port, 5);
@@ -144,7 +115,7 @@ void setup(void)
   wifiManager.addParameter(&custom_mqtt_pass);
   wifiManager.addParameter(&custom_mqtt_prefix);
 
-  if ( digitalRead(TRIGGER_PIN) == BUTTON_ACTIVE_LEVEL || (!SPIFFS.exists("/config.json")) )
+  if (force)
   {
     // Force enter configuration
     wifiManager.resetSettings();
@@ -173,63 +144,91 @@ void setup(void)
   digitalWrite(LED_PIN, HIGH);
   #endif
 
-  //read updated parameters
-  strcpy(mqtt_secure, custom_mqtt_secure.getValue());
-  strcpy(mqtt_server, custom_mqtt_server.getValue());
-  strcpy(mqtt_port, custom_mqtt_port.getValue());
-  strcpy(mqtt_user, custom_mqtt_user.getValue());
-  strcpy(mqtt_pass, custom_mqtt_pass.getValue());
-  strcpy(mqtt_prefix, custom_mqtt_prefix.getValue());
+  //save the custom parameters to FS
+  if (shouldSaveConfig)
+  {
+    //read updated parameters
+    strncpy(mqtt_secure, custom_mqtt_secure.getValue(), sizeof(mqtt_secure)-1);
+    strncpy(mqtt_server, custom_mqtt_server.getValue(), sizeof(mqtt_server)-1);
+    strncpy(mqtt_port, custom_mqtt_port.getValue(), sizeof(mqtt_port)-1);
+    strncpy(mqtt_user, custom_mqtt_user.getValue(), sizeof(mqtt_user)-1);
+    strncpy(mqtt_pass, custom_mqtt_pass.getValue(), sizeof(mqtt_pass)-1);
+    strncpy(mqtt_prefix, custom_mqtt_prefix.getValue(), sizeof(mqtt_prefix)-1);
+    saveConfig();
+    shouldSaveConfig = false;
+  }
+}
 
-  String tmp = mqtt_port;
-  if (tmp.toInt())
+/***************************************************
+ * Setup
+ */
+void setup(void)
+{
+
+  #ifdef DEBUG
+    Serial.begin(CUST_SERIAL_SPEED);
+  #else
+    Serial.begin(CUST_SERIAL_SPEED,SERIAL_8N1,SERIAL_TX_ONLY);
+    sendToDebug("*IR: non debug init\n");
+  #endif
+
+  // Reset button is checked in loop() within BOOT_BUTTON_WINDOW, boot
+  // is not delayed
+
+  // Init EEPROM
+  EEPROM.begin(sizeof(EEpromData));
+  EEPROM.get(0,EEpromData);
+  if (EEpromData.autoSendMode!=true && EEpromData.autoSendMode!=false)
   {
-    mqtt_port_i = tmp.toInt();
-  } else {
-    mqtt_port_i = DEFAULT_MQTT_PORT;
+    EEpromData.autoSendMode=false;
+    EEPROM.put(0, EEpromData);
+    EEPROM.commit();
   }
-  if (mqtt_secure[0]=='1')
+  if (EEpromData.txCalibration!=TX_CALIBRATION_MAGIC)
   {
-    mqtt_secure_b = true;
-  } else {
-    mqtt_secure_b = false;
+    // EEPROM from previous firmware - no transmitter compensation
+    EEpromData.txCalibration=TX_CALIBRATION_MAGIC;
+    EEpromData.markAdjust=0;
+    EEpromData.spaceAdjust=0;
+    EEPROM.put(0, EEpromData);
+    EEPROM.commit();
   }
 
+  pinMode(TRIGGER_PIN, INPUT);
+
+  #ifdef LED_PIN
+  pinMode(LED_PIN,OUTPUT);
+  #endif
+
   irsend.begin();
-  irrecv.enableIRIn();  // Start the receiver
+  rxCaptureBegin();
 
-  //save the custom parameters to FS
-  if (shouldSaveConfig)
+  bool configured = false;
+  if (SPIFFS.begin())
   {
-    sendToDebug("*IR: saving config\n");
-    DynamicJsonBuffer jsonBuffer;
-    JsonObject& json = jsonBuffer.createObject();
-    json["mqtt_server"] = mqtt_server;
-    json["mqtt_user"] = mqtt_user;
-    json["mqtt_pass"] = mqtt_pass;
-    json["mqtt_prefix"] = mqtt_prefix;
-    json["mqtt_port"] = mqtt_port;
-    json["mqtt_secure"] = mqtt_secure;
-
-    File configFile = SPIFFS.open("/config.json", "w");
-    if (configFile)
-    {
-      char tmpBuff[400];
-      json.printTo(tmpBuff, sizeof(tmpBuff));
-      sendToDebug(String("*IR: writing config: "+String(tmpBuff) + "\n"));
+    sendToDebug("*IR: mounted file system\n");
+    configured = loadConfig();
+    // Recover slot writes interrupted by power loss, chunked upload can't be continued
+    slotDbBegin();
+    SPIFFS.remove(UPLOAD_FILE);
+  }
+  else
+  {
+    sendToDebug("*IR: failed to mount FS\n");
+  }
+  unsigned long configTime = millis();
+  sendToDebug("*IR: Start setup\n");
 
-      json.printTo(configFile);
-      configFile.close();
-    }
-    else
-    {
-      sendToDebug("*IR: failed to open config file for writing\n");
-    }
+  bool fastWifi = configured && fastWifiConnect();
+  if (!fastWifi)
+  {
+    runConfigPortal(!configured);
   }
-  tmp = String("*IR: Connected to "+String(WiFi.SSID())+"\n");
+  updateWifiCache();
+  applyConfig();
+
+  String tmp = String("*IR: Connected to "+String(WiFi.SSID())+"\n");
   sendToDebug(tmp);
-  //tmp = String("*IR: IP address: "+String(WiFi.localIP())+"\n");
-  //sendToDebug(tmp);
 
   clientName += "IRGW-";
   uint8_t mac[6];
@@ -238,12 +237,45 @@ void setup(void)
   clientName += "-";
   clientName += String(micros() & 0xff, 16);
 
-  connect_to_MQTT();
+  MQTTsetup();
 
   loadDefaultIR();
-}
 
+  bootInfo = String("Config=") + configTime + ";WiFi=" + millis() + (fastWifi ? ";Fast=1" : ";Fast=0");
+  sendToDebug(String("*IR: Boot ")+bootInfo+"\n");
+}
 
+/***************************************************
+ * Reset button within BOOT_BUTTON_WINDOW after setup() finished, held for
+ * BOOT_BUTTON_HOLD starts configuration portal.
+ * Sampled from loop() - on ESP01 button is on GPIO2 which can't be
+ * held down at power up. Window starts with the first loop(), as WiFi
+ * connection in setup() may take longer than the window.
+ * @returns true while boot window is open (button doesn't send codes)
+ */
+static bool bootButtonCheck()
+{
+  static bool windowOpen = true;
+  static unsigned long windowStart = millis(); // first call
+  static unsigned long pressStart = 0;
+  if (!windowOpen)
+    return false;
+  if (digitalRead(TRIGGER_PIN) != BUTTON_ACTIVE_LEVEL)
+  {
+    pressStart = 0;
+    windowOpen = millis() - windowStart <= BOOT_BUTTON_WINDOW;
+    return windowOpen;
+  }
+  if (pressStart == 0)
+    pressStart = millis();
+  else if (millis() - pressStart >= BOOT_BUTTON_HOLD)
+  {
+    sendToDebug("*IR: Reset button - configuration portal\n");
+    runConfigPortal(true);
+    ESP.restart();
+  }
+  return true;
+}
 
 /****************************************************************
  * Main loop
@@ -251,104 +283,32 @@ void setup(void)
 void loop(void)
 {
 
-  if (MQTTMode)
-  {
-    mqttClient.loop();
-
-    if (! mqttClient.connected())
-    {
-
-      sendToDebug("*IR: Not connected to MQTT....\n");
-      delay(2000);
-      connect_to_MQTT();
-    }
-    decode_results  results;        // Somewhere to store the results
-    if (irrecv.decode(&results))
-    {  // Grab an IR code
-      char myTopic[100];
-      char myTmp[50];
-      char myValue[500];
-      getIrEncoding (&results, myTmp);
-      if (results.decode_type == PANASONIC)
-      { //Panasonic has address
-        // structure "prefix/typ/bits[/panasonic_address]"
-        sprintf(myTopic, "%s/receiver/%s/%d/%d", mqtt_prefix, myTmp, results.bits, results.address );
-      }
-      else
-      {
-        sprintf(myTopic, "%s/receiver/%s/%d", mqtt_prefix, myTmp, results.bits );
-      }
-      if (results.decode_type != UNKNOWN)
-      {
-        // any other has code and bits
-        sprintf(myValue, "%l", results.value);
-        mqttClient.publish((char*) myTopic, (char*) myValue );
-      }
-      else if (rawMode==true)
-      {
-        // RAW MODE
-        String myString;
-        for (int i = 1;  i < results.rawlen;  i++)
-        {
-          myString+= (results.rawbuf[i] * RAWTICK);
-          if ( i < results.rawlen-1 )
-            myString+=","; // ',' not needed on last one
-        }
-        myString.toCharArray(myValue,500);
-        sprintf(myTopic, "%s/receiver/raw", mqtt_prefix );
-        mqttClient.publish( (char*) myTopic, (char*) myValue );
-      }
-      irrecv.resume();              // Prepare for the next value
-    }
-  }
-  else if (millis() - lastTSMQTTReconect > 60000)
-  {
-    // Try to reconnect MQTT every 60 seconds if dev is in nonmqtt mode
-    mqttClient.loop();
-
-    if (! mqttClient.connected())
-    {
-      sendToDebug("*IR: Not connected to MQTT....\n");
-      delay(2000);
-      connect_to_MQTT();
-    }
-    lastTSMQTTReconect = millis();
-  }
+  rxCapturePoll();
+  MQTTloop();
+  txQueueRun();
+  rxCaptureLoop();
+  metricsLoop();
+  healthLoop();
+  rxFilterLoop();
+  slotDbLoop();
 
   bool newButtonState = digitalRead(TRIGGER_PIN);
+  if (bootButtonCheck())
+    newButtonState = buttonState; // boot window - button is only reset trigger
 
   // Manual force of sequence
   if (buttonState != newButtonState && newButtonState == BUTTON_ACTIVE_LEVEL)
   {
     // Button pressed - send 1st code
     lastTSAutoStart=millis(); // delay auto transmission
-    #ifdef LED_PIN
-    digitalWrite(LED_PIN, LOW);
-    #endif
-    if (rawIR1size>0)
-    {
-      sendToDebug("*IR: Button pressed - transmitting 1\n");
-      irsend.sendRaw(rawIR1, rawIR1size, TRANSMITTER_FREQ);
-    }
-    #ifdef LED_PIN
-    digitalWrite(LED_PIN, HIGH);
-    #endif
-
+    sendToDebug("*IR: Button pressed - transmitting 1\n");
+    txQueueAddSlot(1, TX_FRAME_GAP, 1);
   }
   else if (buttonState != newButtonState && newButtonState != BUTTON_ACTIVE_LEVEL)
   {
     // Button released - send 2nd code
-    #ifdef LED_PIN
-    digitalWrite(LED_PIN, LOW);
-    #endif
-    if (rawIR2size>0)
-    {
-      sendToDebug("*IR: Button released - transmitting 2\n");
-      irsend.sendRaw(rawIR2, rawIR2size, TRANSMITTER_FREQ);
-    }
-    #ifdef LED_PIN
-    digitalWrite(LED_PIN, HIGH);
-    #endif
+    sendToDebug("*IR: Button released - transmitting 2\n");
+    txQueueAddSlot(2, TX_FRAME_GAP, 1);
   }
   buttonState = newButtonState;
 
@@ -356,27 +316,15 @@ void loop(void)
   {
     if (autoStartSecond && (millis() - lastTSAutoStart > 3000))
     {
-      if (rawIR2size>0)
-      {
-        sendToDebug("*IR: Auto sender - transmitting 2\n");
-        irsend.sendRaw(rawIR2, rawIR2size, TRANSMITTER_FREQ);
-      }
-      #ifdef LED_PIN
-      digitalWrite(LED_PIN, HIGH);
-      #endif
+      sendToDebug("*IR: Auto sender - transmitting 2\n");
+      txQueueAddSlot(2, TX_FRAME_GAP, 1);
       autoStartSecond = false;
     }
     if (millis() - lastTSAutoStart > autoStartFreq)
     {
       // Autostart
-      #ifdef LED_PIN
-      digitalWrite(LED_PIN, LOW);
-      #endif
-      if (rawIR1size>0)
-      {
-        sendToDebug("*IR: Auto sender - transmitting 1\n");
-        irsend.sendRaw(rawIR1, rawIR1size, TRANSMITTER_FREQ);
-      }
+      sendToDebug("*IR: Auto sender - transmitting 1\n");
+      txQueueAddSlot(1, TX_FRAME_GAP, 1);
       autoStartSecond = true;
       lastTSAutoStart=millis();
     }
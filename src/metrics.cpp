@@ -0,0 +1,108 @@
+#include "globals.h"
+
+/*
+ * Latency metrics
+ *
+ * Every metric is a histogram of durations in microseconds with power of 2
+ * buckets (bucket n holds values from 2^n to 2^(n+1)-1), so p99 is reported
+ * as upper bound of the bucket. Values are collected since boot.
+ */
+
+struct MetricStruct {
+  unsigned long count;
+  unsigned long min;
+  unsigned long max;
+  uint64_t sum;
+  unsigned long buckets[METRIC_BUCKETS];
+};
+
+static const char * const metricNames[METRICS_NUMBER] = {
+  "route",   // METRIC_ROUTE - MQTT message arrival to route resolved
+  "handler", // METRIC_HANDLER - route handler (parse, queue)
+  "slot",    // METRIC_SLOT - slot load (cache or file)
+  "queue",   // METRIC_QUEUE - frame waiting in transmit queue
+  "tx",      // METRIC_TX - IR transmission
+  "rx",      // METRIC_RX - IR decode to MQTT publish
+};
+
+static MetricStruct metrics[METRICS_NUMBER];
+static unsigned long lastMetricsPublish = 0;
+
+/* **************************************************************
+ * Add measured duration
+ * - metric - METRIC_*
+ * - duration - duration in microseconds
+ */
+void metricAdd(uint8_t metric, unsigned long duration)
+{
+  MetricStruct &m = metrics[metric];
+  if (m.count == 0 || duration < m.min)
+    m.min = duration;
+  if (duration > m.max)
+    m.max = duration;
+  m.count++;
+  m.sum += duration;
+  uint8_t bucket = 0;
+  while ((duration >> (bucket+1)) > 0 && bucket < METRIC_BUCKETS-1)
+    bucket++;
+  m.buckets[bucket]++;
+}
+
+/* **************************************************************
+ * 99th percentile (upper bound of bucket)
+ */
+static unsigned long metricP99(const MetricStruct &m)
+{
+  unsigned long threshold = m.count - m.count/100;
+  unsigned long cumulative = 0;
+  for (uint8_t bucket=0;bucket<METRIC_BUCKETS;bucket++)
+  {
+    cumulative += m.buckets[bucket];
+    if (cumulative >= threshold)
+    {
+      unsigned long upper = (2UL << bucket) - 1;
+      return upper < m.max ? upper : m.max;
+    }
+  }
+  return m.max;
+}
+
+/* **************************************************************
+ * Metrics summary: name=count/min/avg/p99/max;... (times in us)
+ */
+String metricsInfo()
+{
+  String result;
+  for (uint8_t i=0;i<METRICS_NUMBER;i++)
+  {
+    const MetricStruct &m = metrics[i];
+    if (i > 0)
+      result += ";";
+    result += metricNames[i];
+    result += "=";
+    result += m.count;
+    result += "/";
+    result += m.min;
+    result += "/";
+    result += m.count ? (unsigned long) (m.sum / m.count) : 0UL;
+    result += "/";
+    result += metricP99(m);
+    result += "/";
+    result += m.max;
+  }
+  return result;
+}
+
+/* **************************************************************
+ * Periodic publishing of metrics, called from loop()
+ */
+void metricsLoop()
+{
+  if (millis() - lastMetricsPublish < METRICS_PERIOD)
+    return;
+  lastMetricsPublish = millis();
+  if (mqttClient.connected())
+  {
+    mqttClient.publish(getTopic(TOPIC_METRICS), metricsInfo().c_str());
+  }
+}
@@ -1,480 +1,847 @@
 #include "globals.h"
 
 /* **************************************************************
- * Processing MQTT message
+ * Ignore own responses
  */
-void MQTTcallback(char* topic, byte* payload, unsigned int length)
+static void handleIgnore(MQTTRequestStruct &)
 {
-  int i = 0;
-
-  char messageBuf[MQTT_MAX_PACKET_SIZE];
-  for (unsigned int i = 0; i < length; i++)
-  {
-    char tempString[2];
-    tempString[0] = (char)payload[i];
-    tempString[1] = '\0';
-    if (i == 0)
-      strcpy(messageBuf, tempString);
-    else
-      strcat(messageBuf, tempString);
-  }
-
-  String msgString = String(messageBuf);
-  String topicString = String(topic);
-
-  unsigned long msgInt = StrToUL(msgString);
-  sendToDebug("*IR: ======= NEW MESSAGE ======\n");
-  sendToDebug(String("*IR: Topic: \"")+topicString+"\"\n");
-  sendToDebug(String("*IR: Message: \"")+msgString+"\"\n");
-  sendToDebug(String("*IR: Length: ")+String(length,DEC)+"\n");
+  sendToDebug("*IR: Ignore own response\n");
+}
 
-  String topicSuffix = topicString.substring(strlen(mqtt_prefix));
-  sendToDebug(String("*IR: Prefix: ")+mqtt_prefix+"\n");
-  sendToDebug(String("*IR: Extracted suffix:\"") + topicSuffix + "\"\n");
+/* **************************************************************
+ * Reboot device
+ */
+static void handleReboot(MQTTRequestStruct &)
+{
+  sendToDebug("*IR: reboot\n");
+  ESP.restart();
+}
 
-  sendToDebug(String("*IR: Payload String: \"") + msgString + "\"\n");
-  if (topicSuffix==SUFFIX_RAWMODE_VAL || topicSuffix==SUFFIX_CMD_RESULT)
+/* **************************************************************
+ * Wipe config file
+ */
+static void handleWipe(MQTTRequestStruct &)
+{
+  if (SPIFFS.exists("/config.json"))
   {
-    sendToDebug("*IR: Ignore own response\n");
-    // Ignore own responses
-    return;
+    SPIFFS.remove("/config.json");
   }
-  else if (topicSuffix==SUFFIX_REBOOT)
+  if (SPIFFS.exists(CONFIG_CACHE_FILE))
   {
-    sendToDebug("*IR: reboot\n");
-    ESP.restart();
+    SPIFFS.remove(CONFIG_CACHE_FILE);
   }
-  else if (topicSuffix==SUFFIX_WIPE)
+  sendToDebug("*IR: Wipe config\n");
+}
+
+/* **************************************************************
+ * Publish result on SUFFIX_CMD_RESULT, streamed so it may be longer
+ * than MQTT buffer
+ */
+static void publishResult(const String &replay)
+{
+  if (mqttClient.beginPublish(getTopic(TOPIC_CMD_RESULT), replay.length(), false))
   {
-    if (SPIFFS.exists("/config.json"))
-    {
-      SPIFFS.remove("/config.json");
-    }
-    sendToDebug("*IR: Wipe config\n");
+    mqttClient.write((const uint8_t *) replay.c_str(), replay.length());
+    mqttClient.endPublish();
   }
-  else if (topicSuffix==SUFFIX_CMD)
-  {
-    sendToDebug("*IR: execute command\n");
-    String replay;
+}
 
-    if (msgString=="ls")
+/* **************************************************************
+ * Execute command, result is published on SUFFIX_CMD_RESULT
+ */
+static void handleCmd(MQTTRequestStruct &req)
+{
+  sendToDebug("*IR: execute command\n");
+  String replay;
+
+  if (strcmp(req.msg, "ls")==0)
+  {
+    replay="";
+    Dir dir = SPIFFS.openDir("/");
+    while (dir.next())
     {
-      replay="";
-      Dir dir = SPIFFS.openDir("/");
-      while (dir.next())
-      {
-        replay+=dir.fileName();
-        replay+="=";
-        File f = dir.openFile("r");
-        replay+= f.size();
-        replay+=";";
-      }
-      FSInfo fs_info;
-      SPIFFS.info(fs_info);
-      replay+="Total bytes=";
-      replay+=fs_info.totalBytes;
+      replay+=dir.fileName();
+      replay+="=";
+      File f = dir.openFile("r");
+      replay+= f.size();
       replay+=";";
-      replay+="Used bytes=";
-      replay+=fs_info.usedBytes;
     }
-    else if (msgString =="sysinfo")
+    FSInfo fs_info;
+    SPIFFS.info(fs_info);
+    replay+="Total bytes=";
+    replay+=fs_info.totalBytes;
+    replay+=";";
+    replay+="Used bytes=";
+    replay+=fs_info.usedBytes;
+  }
+  else if (strcmp(req.msg, "sysinfo")==0)
+  {
+    uint32_t realSize = ESP.getFlashChipRealSize();
+    uint32_t ideSize = ESP.getFlashChipSize();
+    FlashMode_t ideMode = ESP.getFlashChipMode();
+    replay = "Chip id:"+String(ESP.getChipId(), HEX);
+    replay+= ";Flash id:"+String(ESP.getFlashChipId(),HEX);
+    replay+= ";Flash real size:"+String(realSize);
+    replay+= ";Flash ide size:"+String(ideSize);
+    replay+= ";Flash ide mode:"+String ((ideMode == FM_QIO ? "QIO" : ideMode == FM_QOUT ? "QOUT" : ideMode == FM_DIO ? "DIO" : ideMode == FM_DOUT ? "DOUT" : "UNKNOWN"));
+    if(ideSize != realSize)
     {
-      uint32_t realSize = ESP.getFlashChipRealSize();
-      uint32_t ideSize = ESP.getFlashChipSize();
-      FlashMode_t ideMode = ESP.getFlashChipMode();
-      replay = "Chip id:"+String(ESP.getChipId(), HEX);
-      replay+= ";Flash id:"+String(ESP.getFlashChipId(),HEX);
-      replay+= ";Flash real size:"+String(realSize);
-      replay+= ";Flash ide size:"+String(ideSize);
-      replay+= ";Flash ide mode:"+String ((ideMode == FM_QIO ? "QIO" : ideMode == FM_QOUT ? "QOUT" : ideMode == FM_DIO ? "DIO" : ideMode == FM_DOUT ? "DOUT" : "UNKNOWN"));
-      if(ideSize != realSize)
-      {
-        replay+="Flash Chip configuration:wrong";
-      }
-      else
-      {
-        replay+="Flash Chip configuration:ok";
-      }
+      replay+=";Flash Chip configuration:wrong";
     }
     else
     {
-      replay = "command unknown";
-    }
-    String topicCmdResult=String(mqtt_prefix)+ SUFFIX_CMD_RESULT;
-    mqttClient.publish((char *)topicCmdResult.c_str(), (char *)replay.c_str());
-    sendToDebug(String("*IR: Publish on: \"")+ topicCmdResult +"\":"+ replay+"\n");
-  }
-  else if (topicSuffix==SUFFIX_OTA)
-  {
-    t_httpUpdate_return ret = ESPhttpUpdate.update(msgString);
-    delay(500);
-
-    switch(ret) {
-        case HTTP_UPDATE_FAILED:
-            sendToDebug(String("*IR: HTTP_UPDATE_FAILD Error (")
-              + ESPhttpUpdate.getLastError() + "): "+ ESPhttpUpdate.getLastErrorString().c_str()+"\n");
-            break;
-        case HTTP_UPDATE_NO_UPDATES:
-            sendToDebug("*IR: HTTP_UPDATE_NO_UPDATES\n");
-            break;
-        case HTTP_UPDATE_OK:
-            sendToDebug("*IR: HTTP_UPDATE_OK\n");
-            break;
+      replay+=";Flash Chip configuration:ok";
     }
-    delay(500);
+    replay+=";"+healthInfo();
+  }
+  else if (strcmp(req.msg, "cache")==0)
+  {
+    replay = slotCacheInfo();
+  }
+  else if (strcmp(req.msg, "txqueue")==0)
+  {
+    replay = txQueueInfo();
+  }
+  else if (strcmp(req.msg, "metrics")==0)
+  {
+    replay = metricsInfo();
+  }
+  else if (strcmp(req.msg, "slots")==0)
+  {
+    replay = slotDbInfo();
+  }
+  else if (strcmp(req.msg, "slotsreset")==0)
+  {
+    replay = slotDbReset() ? "Slot database reset" : "Slot database not reset";
+  }
+  else if (strcmp(req.msg, "receiver")==0)
+  {
+    replay = rxCaptureInfo() + ";" + rxFilterInfo() + ";" + rxMatchInfo();
+  }
+  else if (strcmp(req.msg, "macros")==0)
+  {
+    replay = macroInfo();
+  }
+  else if (strncmp(req.msg, "calibrate", strlen("calibrate"))==0)
+  {
+    replay = txCalibrate(req.msg);
+  }
+  else
+  {
+    replay = "command unknown";
+  }
+  publishResult(replay);
+  sendToDebug(String("*IR: Publish on: \"")+ getTopic(TOPIC_CMD_RESULT) +"\":"+ replay+"\n");
+}
+
+/* **************************************************************
+ * OTA update from given URL
+ */
+static void handleOta(MQTTRequestStruct &req)
+{
+  t_httpUpdate_return ret = ESPhttpUpdate.update(String(req.msg));
+  delay(500);
+
+  switch(ret) {
+      case HTTP_UPDATE_FAILED:
+          sendToDebug(String("*IR: HTTP_UPDATE_FAILD Error (")
+            + ESPhttpUpdate.getLastError() + "): "+ ESPhttpUpdate.getLastErrorString().c_str()+"\n");
+          break;
+      case HTTP_UPDATE_NO_UPDATES:
+          sendToDebug("*IR: HTTP_UPDATE_NO_UPDATES\n");
+          break;
+      case HTTP_UPDATE_OK:
+          sendToDebug("*IR: HTTP_UPDATE_OK\n");
+          break;
+  }
+  delay(500);
+}
+
+/* **************************************************************
+ * Check if message is "1", "ON" or "true"
+ */
+static bool isMsgTrue(MQTTRequestStruct &req)
+{
+  return strcmp(req.msg, "1")==0 || strcmp(req.msg, "ON")==0 || strcmp(req.msg, "true")==0;
+}
+
+/* **************************************************************
+ * Enable/disable raw mode of receiver
+ */
+static void handleRawMode(MQTTRequestStruct &req)
+{
+  sendToDebug(String("*IR: Publish rawmode status on: \"")+getTopic(TOPIC_RAWMODE_VAL)+"\"\n" );
+  rawMode = isMsgTrue(req);
+  mqttClient.publish(getTopic(TOPIC_RAWMODE_VAL), rawMode ? "true" : "false");
+}
+
+/* **************************************************************
+ * Select format of raw mode receiver: "csv" (receiver/raw) or
+ * "b64" (compact binary on receiver/rawb)
+ */
+static void handleRawFormat(MQTTRequestStruct &req)
+{
+  rawBinary = strcmp(req.msg, "b64")==0;
+  mqttClient.publish(getTopic(TOPIC_RAWFORMAT_VAL), rawBinary ? "b64" : "csv");
+}
+
+/* **************************************************************
+ * Enable/disable auto sender
+ */
+static void handleAutoSendMode(MQTTRequestStruct &req)
+{
+  EEpromData.autoSendMode = isMsgTrue(req);
+  sendToDebug(EEpromData.autoSendMode ? "*IR: AutoSend enabled\n" : "*IR: AutoSend disabled\n");
+  mqttClient.publish(getTopic(TOPIC_AUTOSENDMODE_VAL), EEpromData.autoSendMode ? "true" : "false");
+  EEPROM.put(0, EEpromData);
+  EEPROM.commit();
+}
 
+/* **************************************************************
+ * Transmit raw code from slot given in message (number or name)
+ */
+static void handleSendStoredRaw(MQTTRequestStruct &req)
+{
+  sendToDebug(String("*IR: raw send request from slot:")+req.msg+"\n");
+  int slotNo = isNumber(req.msg) ? atoi(req.msg) : slotDbFind(req.msg);
+  if (txQueueAddSlot(slotNo, TX_FRAME_GAP, 1))
+  {
+    sendToDebug("*IR: raw data from slot queued\n");
   }
-  else if (topicSuffix==SUFFIX_RAWMODE)
+  else
   {
-      String topicRawModeVal=String(mqtt_prefix)+ SUFFIX_RAWMODE_VAL;
-      sendToDebug(String("*IR: Publish rawmode status on: \"")+topicRawModeVal+"\"\n" );
-    if (msgString=="1" || msgString=="ON" || msgString=="true")
-    {
-      mqttClient.publish(topicRawModeVal.c_str(),"true");
-      rawMode=true;
-    }
-    else
-    {
-      mqttClient.publish(topicRawModeVal.c_str(),"false");
-      rawMode=false;
-    }
+    sendToDebug("*IR: wrong slot\n");
+  }
+}
 
+/* **************************************************************
+ * Transmit raw codes from slots given in message
+ * (steps of macro: "slot[*repeats][@gap](,...)")
+ */
+static void handleSendStoredRawSeq(MQTTRequestStruct &req)
+{
+  sendToDebug(String("*IR: Sending sequence: ")+req.msg+"\n");
+  MacroStruct macro;
+  if (macroCompile(req.msg, macro)<0 || macro.name[0]!='\0')
+  {
+    sendToDebug("*IR: Wrong sequence\n");
+    return;
   }
-  else if (topicSuffix==SUFFIX_AUTOSENDMODE)
+  if (!macroPlay(macro))
   {
-    String topicAutoSendModeVal=String(mqtt_prefix)+SUFFIX_AUTOSENDMODE_VAL;
-    if (msgString=="1" || msgString=="ON" || msgString=="true")
-    {
-      sendToDebug("*IR: AutoSend enabled\n");
-      mqttClient.publish(topicAutoSendModeVal.c_str(),"true");
-      EEpromData.autoSendMode = true;
-    } else {
-      sendToDebug("*IR: AutoSend disabled\n");
-      mqttClient.publish(topicAutoSendModeVal.c_str(),"false");
-      EEpromData.autoSendMode = false;
-    }
-    EEPROM.put(0, EEpromData);
-    EEPROM.commit();
+    sendToDebug("*IR: Sequence not queued\n");
   }
-  else if (topicSuffix==SUFFIX_SENDSTOREDRAW)
+}
+
+/* **************************************************************
+ * Compile and store macro (_mqtt_prefix_/sender/storeMacro/macro_ID),
+ * empty message removes macro
+ */
+static void handleStoreMacro(MQTTRequestStruct &req)
+{
+  int macroNo = req.argsNo>0 ? req.args[0] : -1;
+  MacroStruct macro;
+  if (req.msg[0] == '\0')
   {
-    sendToDebug(String("*IR: raw send request from slot:")+msgString+"\n");
-    int slotNo=msgString.toInt();
-    if (slotNo>0 && slotNo<=SLOTS_NUMBER)
-    {
-      char fName[20];
-      sprintf(fName,"/ir/%d.dat",slotNo);
-      uint16_t size = readDataFile(fName, rawIrData);
-      if (size>0)
-      {
-        sendToDebug("*IR: transmitting raw data from slot\n");
-        irsend.sendRaw(rawIrData, size-1, (uint16_t)rawIrData[size-1]);
-      }
-    }
-    else
-    {
-      sendToDebug("*IR: wrong slot\n");
-    }
+    memset(&macro, 0, sizeof(macro));
   }
-  else if (topicSuffix==SUFFIX_SENDSTORERAWSEQ)
+  else
   {
-    sendToDebug(String("*IR: Sending sequence: ")+msgString);
-    unsigned int msgLen = msgString.length();
-    String allowedChars = String("0123456789,");
-    for (int i=0;i< msgLen;i++)
-    {
-      if (allowedChars.indexOf(msgString[i])==-1)
-      {
-        return;
-      }
-    }
-    // Coma at begin or end is not allowed
-    if (msgString[0]==',' || msgString[msgLen-1]==',')
+    int result = macroCompile(req.msg, macro);
+    if (result<0)
     {
+      sendToDebug(String("*IR: Wrong macro, error: ")+result+"\n");
       return;
     }
-    // We have proper slot number and proper message - so we can load it into store slot
-    int commIdx=0;
-    int commIdxPrev=0;
-    int elementIdx=0;
-    // Parse message context
-    do
+    int owner = macro.name[0] ? macroFind(macro.name) : -1;
+    if (owner>0 && owner!=macroNo)
     {
-      commIdx=msgString.indexOf(',',commIdxPrev);
-      if (commIdx>-1)
-      {
-        // Not last element
-        String tmpString=msgString.substring(commIdxPrev,commIdx);
-        commIdxPrev=commIdx+1;
-        // store in array
-        if (elementIdx>SEQ_SIZE)
-        {
-          return;
-        }
-        rawSequence[elementIdx]=tmpString.toInt();
-      }
-      else
-      {
-        // Last element
-        String tmpString=msgString.substring(commIdxPrev);
-        if (elementIdx>SEQ_SIZE)
-        {
-          return;
-        }
-        rawSequence[elementIdx]=tmpString.toInt();
-      }
-      elementIdx++;
-    } while (commIdx>-1);
-    // Sending of ir codes sequnece
-    for (int i=0;i<elementIdx;i++)
-    {
-      int slotNo=rawSequence[i];
-      if (slotNo>0 && slotNo<=SLOTS_NUMBER)
-      {
-        char fName[20];
-        sprintf(fName,"/ir/%d.dat",slotNo);
-        sendToDebug(String("*IR: Read file %s\n")+fName);
-        uint16_t size = readDataFile(fName, rawIrData);
-        if (size>0)
-        {
-          sendToDebug("*IR: File content:");
-          for (int j=0;j<size;j++)
-          {
-            if (j>0)
-              sendToDebug(",");
-            sendToDebug(String(rawIrData[j]));
-          }
-          sendToDebug("\n*IR: Transmitting raw data sequence\n");
-          irsend.sendRaw(rawIrData, size-1, rawIrData[size-1]);
-        }
-      }
+      sendToDebug("*IR: Macro name is used\n");
+      return;
     }
-    // --------------------------------------------------------------------
+  }
+  if (macroStore(macroNo, macro))
+  {
+    sendToDebug(String("*IR: Macro ")+macroNo+" stored, steps: "+macro.stepsNo+"\n");
   }
   else
   {
-    // structure
-    // - _mqtt_prefix_/sender/typ[/bits[/panasonic_address]]
-    // - _mqtt_prefix_/sender/storeRaw/slot_ID
-    // - _mqtt_prefix_/sender/sendGC
-    int endOfBits;
-    String irTypStr = "";
-    String irBitsStr = "";
-    int irBitsInt=-1;
-    String irPanasAddrStr = "";
-
-    int endOfTyp = topicSuffix.indexOf("/",8);
-    if (endOfTyp == -1)
-    {
-      // One element - only irTyp
-      irTypStr  = topicSuffix.substring(8);
-    }
-    else
+    sendToDebug("*IR: wrong macro\n");
+  }
+}
+
+/* **************************************************************
+ * Transmit macro given in message (number or name)
+ */
+static void handleSendMacro(MQTTRequestStruct &req)
+{
+  int macroNo = isNumber(req.msg) ? atoi(req.msg) : macroFind(req.msg);
+  MacroStruct macro;
+  if (!macroLoad(macroNo, macro))
+  {
+    sendToDebug("*IR: wrong macro\n");
+    return;
+  }
+  sendToDebug(String("*IR: Sending macro ")+macroNo+"\n");
+  if (!macroPlay(macro))
+  {
+    sendToDebug("*IR: Macro not queued\n");
+  }
+}
+
+/* **************************************************************
+ * Store raw code from message in slot (_mqtt_prefix_/sender/storeRaw/slot_ID)
+ */
+static void handleStoreRaw(MQTTRequestStruct &req)
+{
+  int slotNo = req.argsNo>0 ? req.args[0] : -1;
+  if (slotNo<1 || slotNo>SLOTS_NUMBER)
+  {
+    sendToDebug("*IR: wrong slot\n");
+    return;
+  }
+  int elementIdx = parseNumberList(req.payload, req.length, rawIrData, SLOT_SIZE+1);
+  if (elementIdx<0)
+  {
+    sendToDebug("*IR: Wrong message format\n");
+    return;
+  }
+  sendToDebug(String("*IR: Elements to write: ")+elementIdx+"\n");
+  if (!slotDbWrite(slotNo, rawIrData, elementIdx))
+  {
+    return;
+  }
+  sendToDebug("*IR: Slot written\n");
+  slotCacheUpdate(slotNo);
+}
+
+/* **************************************************************
+ * Part of chunked upload (_mqtt_prefix_/sender/storeRaw/slot_ID/part/n),
+ * errors are published on SUFFIX_CMD_RESULT
+ */
+static void handleStoreRawPart(MQTTRequestStruct &req)
+{
+  if (req.argsNo != 2)
+  {
+    sendToDebug("*IR: wrong part\n");
+    return;
+  }
+  String replay = uploadPart(req.args[0], req.args[1], req.payload, req.length);
+  if (replay.length())
+  {
+    sendToDebug(String("*IR: Upload: ")+replay+"\n");
+    publishResult(replay);
+  }
+}
+
+/* **************************************************************
+ * Store uploaded parts in slot (_mqtt_prefix_/sender/storeRaw/slot_ID/commit),
+ * result is published on SUFFIX_CMD_RESULT
+ */
+static void handleStoreRawCommit(MQTTRequestStruct &req)
+{
+  String replay = uploadCommit(req.argsNo>0 ? req.args[0] : -1, req.msg);
+  sendToDebug(String("*IR: Upload: ")+replay+"\n");
+  publishResult(replay);
+}
+
+/* **************************************************************
+ * Set name of slot (_mqtt_prefix_/sender/slotName/slot_ID), empty message
+ * removes name
+ */
+static void handleSlotName(MQTTRequestStruct &req)
+{
+  int slotNo = req.argsNo>0 ? req.args[0] : -1;
+  if (slotDbSetName(slotNo, req.msg))
+  {
+    sendToDebug(String("*IR: Slot ")+slotNo+" name: \""+req.msg+"\"\n");
+  }
+  else
+  {
+    sendToDebug("*IR: wrong slot or name\n");
+  }
+}
+
+/* **************************************************************
+ * Send Global Cache code from message
+ */
+static void handleSendGC(MQTTRequestStruct &req)
+{
+  int elementIdx = parseNumberList(req.payload, req.length, rawIrData, SLOT_SIZE+1);
+  if (elementIdx<0)
+  {
+    sendToDebug("*IR: Wrong message format\n");
+    return;
+  }
+  sendToDebug(String("*IR: Send GC, elements to send: ")+elementIdx+"\n");
+  txQueueAddGC(rawIrData, elementIdx, TX_FRAME_GAP);
+}
+
+/* **************************************************************
+ * Send raw code from message, last element is frequency
+ */
+static void handleSendRaw(MQTTRequestStruct &req)
+{
+  int elementIdx = parseNumberList(req.payload, req.length, rawIrData, SLOT_SIZE+1);
+  if (elementIdx<0)
+  {
+    sendToDebug("*IR: Wrong message format\n");
+    return;
+  }
+  sendToDebug(String("*IR: Send RAW from MQTT, elements: ")+(elementIdx-1)+", frequency="+rawIrData[elementIdx-1]+"kHz\n");
+  txQueueAddRaw(rawIrData, elementIdx-1, rawIrData[elementIdx-1], TX_FRAME_GAP, 1);
+}
+
+/* **************************************************************
+ * Send raw code from message in compact binary format
+ */
+static void handleSendRawBinary(MQTTRequestStruct &req)
+{
+  uint16_t freq;
+  int elementIdx = decodeRawBinary(req.payload, req.length, rawIrData, SLOT_SIZE, &freq);
+  if (elementIdx<0)
+  {
+    sendToDebug("*IR: Wrong message format\n");
+    return;
+  }
+  if (freq == 0)
+    freq = TRANSMITTER_FREQ;
+  sendToDebug(String("*IR: Send binary RAW from MQTT, elements: ")+elementIdx+", frequency="+freq+"kHz\n");
+  txQueueAddRaw(rawIrData, elementIdx, freq, TX_FRAME_GAP, 1);
+}
+
+/* **************************************************************
+ * Send code of given type (_mqtt_prefix_/sender/typ[/bits[/panasonic_address]])
+ */
+static void handleIrSend(MQTTRequestStruct &req)
+{
+  uint64_t msgInt = StrToULL(req.msg);
+  const IRProtocolStruct *protocol = irProtocolFind(req.name);
+  if (protocol == NULL || protocol->sendFunction == NULL)
+  {
+    sendToDebug(String("*IR: Protocol not supported: ")+req.name+"\n");
+    return;
+  }
+  int irBitsInt = req.argsNo>0 ? req.args[0] : protocol->bits;
+  sendToDebug(String("*IR: Send ")+req.name+":"+req.msg+" (bits: "+irBitsInt+")\n");
+  txQueueAddCode(protocol->sendFunction, msgInt, irBitsInt, TX_FRAME_GAP);
+}
+
+/* **************************************************************
+ * Queue single action of batch
+ * - action - {"type": "NEC|RC5|...|slot|raw|gc|macro", "value": ..., "bits": n,
+ *   "slot": n|name, "delay": ms}
+ * @returns false if action is wrong or was not queued
+ */
+static bool queueBatchAction(JsonObject &action)
+{
+  const char *type = action["type"] | "slot";
+  uint16_t gap = action["delay"] | TX_FRAME_GAP;
+  if (strcmp(type, "slot")==0)
+  {
+    JsonVariant slot = action["slot"];
+    int slotNo = slot.is<const char*>() ? slotDbFind(slot.as<const char*>()) : slot.as<int>();
+    return txQueueAddSlot(slotNo, gap, 1);
+  }
+  if (strcmp(type, "macro")==0)
+  {
+    JsonVariant value = action["value"];
+    MacroStruct macro;
+    int macroNo = value.is<const char*>() ? macroFind(value.as<const char*>()) : value.as<int>();
+    return macroLoad(macroNo, macro) && macroPlay(macro);
+  }
+  if (strcmp(type, "raw")==0 || strcmp(type, "gc")==0)
+  {
+    const char *value = action["value"] | "";
+    int elementIdx = parseNumberList((const byte *) value, strlen(value), rawIrData, SLOT_SIZE+1);
+    if (elementIdx<0)
+      return false;
+    if (type[0] == 'g')
+      return txQueueAddGC(rawIrData, elementIdx, gap);
+    return elementIdx>1 && txQueueAddRaw(rawIrData, elementIdx-1, rawIrData[elementIdx-1], gap, 1);
+  }
+  const IRProtocolStruct *protocol = irProtocolFind(type);
+  if (protocol == NULL || protocol->sendFunction == NULL)
+    return false;
+  // Code up to 64 bits - decimal string or number (ARDUINOJSON_USE_LONG_LONG)
+  JsonVariant value = action["value"];
+  uint64_t code = value.is<const char*>() ? StrToULL(value.as<const char*>()) : value.as<unsigned long long>();
+  return txQueueAddCode(protocol->sendFunction, code, action["bits"] | (int) protocol->bits, gap);
+}
+
+/* **************************************************************
+ * Queue array of actions from JSON message, summary is published on
+ * SUFFIX_CMD_RESULT: "Actions=n;Queued=n[;Failed=i,j,...]"
+ */
+static void handleBatch(MQTTRequestStruct &req)
+{
+  DynamicJsonBuffer jsonBuffer;
+  JsonArray& actions = jsonBuffer.parseArray(req.msg);
+  String replay;
+  if (!actions.success())
+  {
+    replay = "Batch: wrong JSON";
+  }
+  else
+  {
+    int queued = 0;
+    String failed;
+    for (size_t i=0;i<actions.size();i++)
     {
-      // irTyp exists i cos dalej
-      irTypStr  = topicSuffix.substring(8, endOfTyp);
-      endOfBits = topicSuffix.indexOf("/",endOfTyp+1);
-      if (endOfBits== -1)
+      JsonObject &action = actions[i];
+      if (action.success() && queueBatchAction(action))
       {
-        // irBits jest na koncy
-        irBitsStr = topicSuffix.substring(endOfTyp+1);
+        queued++;
       }
       else
       {
-        // irBits i cos dalej
-        irBitsStr = topicSuffix.substring(endOfTyp+1, endOfBits);
-        irPanasAddrStr = topicSuffix.substring(endOfBits+1);
+        failed += failed.length() ? "," : "";
+        failed += i;
       }
-      irBitsInt = irBitsStr.toInt();
     }
+    replay = String("Actions=")+actions.size()+";Queued="+queued;
+    if (failed.length())
+      replay += ";Failed="+failed;
+  }
+  publishResult(replay);
+  sendToDebug(String("*IR: Batch: ")+replay+"\n");
+}
 
-    sendToDebug(String("*IR: TypStr=") + irTypStr+"\n");
-    sendToDebug(String("*IR: irBitrStr=")+ irBitsStr+"\n");
-    sendToDebug(String("*IR: irPanasAddrStr=")+irPanasAddrStr+"\n");
+/* **************************************************************
+ * Routes - topic suffix (without numeric elements) and its handler.
+ * Suffixes not found here are handled by handleIrSend.
+ */
+static const MQTTRouteStruct mqttRoutes[] = {
+  { SUFFIX_CMD_RESULT,       handleIgnore },
+  { SUFFIX_RAWMODE_VAL,      handleIgnore },
+  { SUFFIX_AUTOSENDMODE_VAL, handleIgnore },
+  { SUFFIX_RAWFORMAT_VAL,    handleIgnore },
+  { SUFFIX_REBOOT,           handleReboot },
+  { SUFFIX_WIPE,             handleWipe },
+  { SUFFIX_CMD,              handleCmd },
+  { SUFFIX_OTA,              handleOta },
+  { SUFFIX_RAWMODE,          handleRawMode },
+  { SUFFIX_AUTOSENDMODE,     handleAutoSendMode },
+  { SUFFIX_SENDSTOREDRAW,    handleSendStoredRaw },
+  { SUFFIX_SENDSTORERAWSEQ,  handleSendStoredRawSeq },
+  { SUFFIX_STORERAW,         handleStoreRaw },
+  { SUFFIX_STORERAW_PART,    handleStoreRawPart },
+  { SUFFIX_STORERAW_COMMIT,  handleStoreRawCommit },
+  { SUFFIX_SLOTNAME,         handleSlotName },
+  { SUFFIX_STOREMACRO,       handleStoreMacro },
+  { SUFFIX_SENDMACRO,        handleSendMacro },
+  { SUFFIX_BATCH,            handleBatch },
+  { SUFFIX_SENDGC,           handleSendGC },
+  { SUFFIX_SENDRAW,          handleSendRaw },
+  { SUFFIX_SENDRAWB,         handleSendRawBinary },
+  { SUFFIX_RAWFORMAT,        handleRawFormat },
+};
+#define ROUTES_NUMBER (sizeof(mqttRoutes)/sizeof(mqttRoutes[0]))
+#define ROUTE_EMPTY 0xFF
 
-    if (irTypStr=="storeRaw" || irTypStr == "sendGC" || irTypStr == "sendRAW")
-    {
-      unsigned int msgLen = msgString.length();
-      String allowedChars = String("0123456789,");
-      for (int i=0;i< msgLen;i++)
-      {
-        if (allowedChars.indexOf(msgString[i])==-1)
-        {
-          return;
-        }
-      }
-      // Coma at begin or end is not allowed
-      if (msgString[0]==',' || msgString[msgLen-1]==',')
-      {
-        return;
-      }
-      // We have proper slot number and proper message - so we can load it into store slot
-      int commIdx=0;
-      int commIdxPrev=0;
-      int elementIdx=0;
-      // Parse message context
-      sendToDebug("*IR: Start parsing message\n");
-      do
-      {
-        commIdx=msgString.indexOf(',',commIdxPrev);
-        if (commIdx>-1)
-        {
-          // Not last element
-          String tmpString=msgString.substring(commIdxPrev,commIdx);
-          commIdxPrev=commIdx+1;
-          // store in array
-          rawIrData[elementIdx]=tmpString.toInt();
-        }
-        else
-        {
-          // Last element
-          String tmpString=msgString.substring(commIdxPrev);
-          rawIrData[elementIdx]=tmpString.toInt();
-        }
-        elementIdx++;
-      } while (commIdx>-1);
-      if (irTypStr=="storeRaw" && irBitsInt>0 && irBitsInt<=SLOTS_NUMBER)
-      {
-        // Store Raw
-        sendToDebug("*IR: Start storeRaw\n");
-        char fName[20];
-        sprintf(fName,"/ir/%d.dat",irBitsInt);
-        sendToDebug("*IR: Parsing finished\n");
-        sendToDebug(String("*IR: Write to file: ")+fName+"\n");
-        sendToDebug(String("*IR: Elements to write: ")+elementIdx+"\n");
-        writeDataFile(fName, rawIrData, elementIdx);
-        sendToDebug("*IR: File written\n");
-
-        if (irBitsInt == 1 or irBitsInt ==2)
-        {
-          sendToDebug("*IR: read files for default player\n");
-          loadDefaultIR();
-        }
-      }
-      else if (irTypStr == "sendGC")
-      {
-        // Send GC
-        sendToDebug("*IR: Send GC\n");
-        sendToDebug(String("*IR: Elements to send: ")+elementIdx+"\n");
-        irsend.sendGC(rawIrData,elementIdx);
-        sendToDebug("*IR: GC send done.\n");
-      }
-      else if (irTypStr == "sendRAW")
-      {
-        sendToDebug("*IR: Send RAW from MQTT\n");
-        sendToDebug(String("*IR: No of elements to send: ")+(elementIdx-1)+", frequency="+rawIrData[elementIdx-1]+"kHz\n");
-        irsend.sendRaw(rawIrData,elementIdx-1,rawIrData[elementIdx-1]);
-        sendToDebug("*IR: RAW send done.\n");
-      }
-    }
-    else if (irTypStr=="NEC")
-    {
-      sendToDebug(String("*IR: Send NEC:")+msgInt);
-      irsend.sendNEC(msgInt, irBitsInt);
-    }
-    else if (irTypStr=="RC5")
-    {
-      sendToDebug(String("*IR: Send RC5:")+msgInt+" (bits: "+irBitsInt+")\n");
-      irsend.sendRC5(msgInt, irBitsInt);
-    }
-    else if (irTypStr=="RC6")
-    {
-      sendToDebug(String("*IR: Send RC6:")+msgInt+" (bits: "+irBitsInt+")\n");
-      irsend.sendRC6(msgInt, irBitsInt);
-    }
-    else if (irTypStr=="LG")
+static_assert(ROUTES_NUMBER*2 <= ROUTE_INDEX_SIZE, "ROUTE_INDEX_SIZE too small");
+static_assert((ROUTE_INDEX_SIZE & (ROUTE_INDEX_SIZE-1)) == 0, "ROUTE_INDEX_SIZE must be power of 2");
+
+static uint8_t routeIndex[ROUTE_INDEX_SIZE]; // hash -> mqttRoutes[] index
+static bool routeIndexReady = false;
+
+/* **************************************************************
+ * Build open addressing hash index of mqttRoutes[]
+ */
+static void buildRouteIndex()
+{
+  memset(routeIndex, ROUTE_EMPTY, sizeof(routeIndex));
+  for (uint8_t i=0;i<ROUTES_NUMBER;i++)
+  {
+    uint32_t pos = strHash(mqttRoutes[i].suffix);
+    while (routeIndex[pos & (ROUTE_INDEX_SIZE-1)] != ROUTE_EMPTY)
+      pos++;
+    routeIndex[pos & (ROUTE_INDEX_SIZE-1)] = i;
+  }
+  routeIndexReady = true;
+}
+
+/* **************************************************************
+ * Find handler of given suffix
+ * @returns NULL if there is no route
+ */
+static MQTTRouteHandler findRoute(const char *suffix)
+{
+  if (!routeIndexReady)
+    buildRouteIndex();
+  uint32_t pos = strHash(suffix);
+  uint8_t idx;
+  while ((idx = routeIndex[pos & (ROUTE_INDEX_SIZE-1)]) != ROUTE_EMPTY)
+  {
+    if (strcmp(mqttRoutes[idx].suffix, suffix)==0)
+      return mqttRoutes[idx].handler;
+    pos++;
+  }
+  return NULL;
+}
+
+/* **************************************************************
+ * Split topic suffix into route key and numeric arguments,
+ * e.g. "/sender/storeRaw/5" -> "/sender/storeRaw" + [5]
+ * - suffix - topic without mqtt_prefix
+ * - key - destination for route key (ROUTE_KEY_SIZE chars)
+ * - req - request for numeric arguments and name (last key element)
+ * @returns false if topic doesn't fit
+ */
+static bool parseRoute(const char *suffix, char *key, MQTTRequestStruct &req)
+{
+  int keyLen = 0;
+  req.argsNo = 0;
+  req.name = key;
+  while (*suffix == '/')
+  {
+    const char *element = ++suffix;
+    bool numeric = (*element != '\0');
+    unsigned long value = 0;
+    while (*suffix != '\0' && *suffix != '/')
     {
-      sendToDebug(String("*IR: Send LG:")+msgInt+" (bits: "+irBitsInt+")\n");
-      irsend.sendLG(msgInt, irBitsInt);
+      if (*suffix >= '0' && *suffix <= '9')
+        value = value*10 + (*suffix - '0');
+      else
+        numeric = false;
+      suffix++;
     }
-    else if (irTypStr=="SONY")
+    int elementLen = suffix-element;
+    if (numeric)
     {
-      sendToDebug(String("*IR: Send Sony:")+msgInt+" (bits: "+irBitsInt+")\n");
-      irsend.sendSony(msgInt, irBitsInt);
+      if (req.argsNo >= ROUTE_MAX_ARGS)
+        return false;
+      req.args[req.argsNo++] = value;
     }
-    else if (irTypStr=="SAMSUNG")
+    else
     {
-      sendToDebug(String("*IR: Send Samsung:")+msgInt+" (bits: "+irBitsInt+")\n");
-      irsend.sendSAMSUNG(msgInt, irBitsInt);
+      if (keyLen+elementLen+2 > ROUTE_KEY_SIZE)
+        return false;
+      key[keyLen++] = '/';
+      req.name = &key[keyLen];
+      memcpy(&key[keyLen], element, elementLen);
+      keyLen += elementLen;
     }
   }
+  key[keyLen] = '\0';
+  return *suffix == '\0';
+}
 
+/* **************************************************************
+ * Processing MQTT message
+ */
+void MQTTcallback(char* topic, byte* payload, unsigned int length)
+{
+  unsigned long arrival = micros();
+  char *messageBuf = arena.message;
+  unsigned int msgLength = length < sizeof(arena.message) ? length : sizeof(arena.message)-1;
+  memcpy(messageBuf, payload, msgLength);
+  messageBuf[msgLength] = '\0';
+
+  sendToDebug("*IR: ======= NEW MESSAGE ======\n");
+  sendToDebug(String("*IR: Topic: \"")+topic+"\"\n");
+  sendToDebug(String("*IR: Message: \"")+messageBuf+"\"\n");
+  sendToDebug(String("*IR: Length: ")+String(length,DEC)+"\n");
+
+  size_t prefixLen = strlen(mqtt_prefix);
+  if (strncmp(topic, mqtt_prefix, prefixLen) != 0)
+  {
+    return;
+  }
+
+  MQTTRequestStruct req;
+  char routeKey[ROUTE_KEY_SIZE];
+  req.payload = payload;
+  req.length = length;
+  req.msg = messageBuf;
+  if (!parseRoute(topic+prefixLen, routeKey, req))
+  {
+    sendToDebug("*IR: Wrong topic\n");
+    return;
+  }
+  sendToDebug(String("*IR: Route: \"") + routeKey + "\"\n");
+
+  MQTTRouteHandler handler = findRoute(routeKey);
+  if (handler == NULL && strncmp(routeKey, "/sender/", 8)==0 && strchr(routeKey+8, '/')==NULL)
+  {
+    handler = handleIrSend;
+  }
+  if (handler == NULL)
+  {
+    return;
+  }
+  unsigned long routed = micros();
+  metricAdd(METRIC_ROUTE, routed - arrival);
+  handler(req);
+  metricAdd(METRIC_HANDLER, micros() - routed);
 }
 
 
 /************************************************
- *  connect to MQTT broker
+ *  Publish received raw durations as "d1,d2,...,dn" without building
+ *  the message in RAM - digits are written directly to MQTT stream
+ * - topic - destination topic
+ * - rawbuf - raw buffer of IRrecv (first element is not a duration)
+ * - rawlen - number of elements in rawbuf
+ */
+bool publishRawDurations(const char *topic, const volatile uint16_t *rawbuf, uint16_t rawlen)
+{
+  if (rawlen < 2)
+    return false;
+  unsigned int msgLength = rawlen-2; // commas
+  for (uint16_t i=1;i<rawlen;i++)
+  {
+    msgLength += uintDigits(rawbuf[i] * RAWTICK);
+  }
+  if (!mqttClient.beginPublish(topic, msgLength, false))
+    return false;
+  char buf[64];
+  uint8_t bufLen = 0;
+  for (uint16_t i=1;i<rawlen;i++)
+  {
+    if (bufLen > sizeof(buf)-12)
+    {
+      mqttClient.write((const uint8_t *) buf, bufLen);
+      bufLen = 0;
+    }
+    bufLen += uintToStr(rawbuf[i] * RAWTICK, &buf[bufLen]);
+    if (i < rawlen-1)
+      buf[bufLen++] = ',';
+  }
+  mqttClient.write((const uint8_t *) buf, bufLen);
+  return mqttClient.endPublish();
+}
+
+/************************************************
+ *  Publish received raw durations in compact binary format
+ * - topic - destination topic
+ * - rawbuf - raw buffer of IRrecv (first element is not a duration)
+ * - rawlen - number of elements in rawbuf
  */
-void connect_to_MQTT()
+bool publishRawBinary(const char *topic, const volatile uint16_t *rawbuf, uint16_t rawlen)
 {
+  if (rawlen < 2)
+    return false;
+  if (!mqttClient.beginPublish(topic, rawBinaryLength(rawbuf+1, rawlen-1, 0), false))
+    return false;
+  writeRawBinary(mqttClient, rawbuf+1, rawlen-1, 0);
+  return mqttClient.endPublish();
+}
 
-  char myTopic[100];
+/************************************************
+ *  Setup MQTT client
+ */
+void MQTTsetup()
+{
   if (mqtt_secure_b)
   {
-    sendToDebug("*IR: connecting to TLS server:");
+    sendToDebug("*IR: using TLS server:");
     mqttClient.setClient(wifiClientSecure);
   } else {
-    sendToDebug("*IR: connecting to nonTLS server:");
+    sendToDebug("*IR: using nonTLS server:");
     mqttClient.setClient(wifiClient);
   }
   sendToDebug(String(" ")+ mqtt_server+ ":"+ mqtt_port_i +" as " + clientName +"\n");
   mqttClient.setServer(mqtt_server, mqtt_port_i);
   mqttClient.setCallback(MQTTcallback);
-  int conn_counter = 2;
+  topicsBuild();
+}
 
-  while (conn_counter > 0)
+/************************************************
+ *  connect to MQTT broker (single attempt)
+ * @returns true if connected
+ */
+bool connect_to_MQTT()
+{
+  sendToDebug(String("*IR: MQTT user:")+ mqtt_user + "\n");
+  sendToDebug("*IR: MQTT pass: ********\n");
+  if (!mqttClient.connect(clientName.c_str(), mqtt_user, mqtt_pass, getTopic(TOPIC_WILL), 2, true, "false"))
   {
-    sendToDebug(String("*IR: MQTT user:")+ mqtt_user + "\n");
-    sendToDebug("*IR: MQTT pass: ********\n");
-    String topicWill = String(mqtt_prefix)+ SUFFIX_WILL;
-    if (mqttClient.connect((char*) clientName.c_str(), (char*)mqtt_user, (char *)mqtt_pass, topicWill.c_str(), 2, true, "false"))
-    {
-      mqttClient.publish(topicWill.c_str(), "true", true);
-      sendToDebug("*IR: Connected to MQTT broker\n");
-      sprintf(myTopic, "%s/info/client", mqtt_prefix);
-      mqttClient.publish((char*)myTopic, (char*) clientName.c_str());
-      IPAddress myIp = WiFi.localIP();
-      char myIpString[24];
-      sprintf(myIpString, "%d.%d.%d.%d", myIp[0], myIp[1], myIp[2], myIp[3]);
-      sprintf(myTopic, "%s/info/ip", mqtt_prefix);
-      mqttClient.publish((char*)myTopic, (char*) myIpString);
-      sprintf(myTopic, "%s/info/type", mqtt_prefix);
-      mqttClient.publish((char*)myTopic,"IR server");
-      sprintf(myTopic, "%s/info/version", mqtt_prefix);
-      mqttClient.publish((char*)myTopic,VERSION);
-      String topicSubscribe = String (mqtt_prefix)+ SUFFIX_SUBSCRIBE;
-      sendToDebug(String("*IR: Topic is: ") + topicSubscribe.c_str()+"\n");
-      if (mqttClient.subscribe(topicSubscribe.c_str()))
-      {
-        sendToDebug("*IR: Successfully subscribed\n");
-        delay(1);
-      }
+    sendToDebug(String("*IR: MQTT connect failed, rc=") + mqttClient.state() + "\n");
+    return false;
+  }
+  mqttClient.publish(getTopic(TOPIC_WILL), "true", true);
+  sendToDebug("*IR: Connected to MQTT broker\n");
+  mqttClient.publish(getTopic(TOPIC_CLIENT), clientName.c_str());
+  IPAddress myIp = WiFi.localIP();
+  char myIpString[24];
+  sprintf(myIpString, "%d.%d.%d.%d", myIp[0], myIp[1], myIp[2], myIp[3]);
+  mqttClient.publish(getTopic(TOPIC_IP), myIpString);
+  mqttClient.publish(getTopic(TOPIC_TYPE), "IR server");
+  mqttClient.publish(getTopic(TOPIC_VERSION), VERSION);
+  static unsigned long mqttReady = 0;
+  if (mqttReady == 0)
+  {
+    // Boot to first MQTT connection
+    mqttReady = millis();
+    bootInfo += ";MQTT=";
+    bootInfo += mqttReady;
+  }
+  mqttClient.publish(getTopic(TOPIC_BOOT), bootInfo.c_str(), true);
+  sendToDebug(String("*IR: Topic is: ") + getTopic(TOPIC_SUBSCRIBE)+"\n");
+  if (mqttClient.subscribe(getTopic(TOPIC_SUBSCRIBE)))
+  {
+    sendToDebug("*IR: Successfully subscribed\n");
+  }
+  return true;
+}
 
-      conn_counter = -1;
-    }
-    else
-    {
-      sendToDebug(String("*IR: MQTT connect failed, rc=") + mqttClient.state() + " try again in 5 seconds\n");
-      // Wait 5 seconds before retrying
-      for (int i = 0; i<10; i++)
-      {
-        #ifdef LED_PIN
-        digitalWrite(LED_PIN, 1-digitalRead(LED_PIN));
-        #endif
-        delay(500);
-      }
-      #ifdef LED_PIN
-      digitalWrite(LED_PIN, HIGH);
-      #endif
-      conn_counter = conn_counter-1;
-    }
+/************************************************
+ *  Keep MQTT connection - called from every loop() iteration.
+ *  Reconnect attempts are spread with exponential backoff and jitter,
+ *  nothing here waits, so IR and button handling keep working while
+ *  broker is not available.
+ */
+void MQTTloop()
+{
+  static bool wasConnected = false;
+  static unsigned long lastAttempt = 0;
+  static unsigned long reconnectDelay = 0; // first attempt without delay
+  static unsigned int failedAttempts = 0;
+  #ifdef LED_PIN
+  static unsigned long lastBlink = 0;
+  #endif
+
+  if (mqttClient.connected())
+  {
+    mqttClient.loop();
+    return;
   }
-  if (conn_counter==0)
+  if (wasConnected)
   {
-    MQTTMode=false;
-    sendToDebug("*IR: Entering non MQTT mode\n");
-  } else {
-    MQTTMode=true;
-    sendToDebug("*IR: Entering MQTT mode\n");
+    sendToDebug("*IR: Not connected to MQTT....\n");
+    wasConnected = false;
+    lastAttempt = millis();
+    reconnectDelay = MQTT_RECONNECT_MIN;
+  }
+  #ifdef LED_PIN
+  if (millis() - lastBlink > 500)
+  {
+    digitalWrite(LED_PIN, 1-digitalRead(LED_PIN));
+    lastBlink = millis();
+  }
+  #endif
+  if (millis() - lastAttempt < reconnectDelay)
+  {
+    return;
+  }
+  if (connect_to_MQTT())
+  {
+    wasConnected = true;
+    failedAttempts = 0;
+    #ifdef LED_PIN
+    digitalWrite(LED_PIN, HIGH);
+    #endif
+    return;
   }
+  // Next attempt after MQTT_RECONNECT_MIN * 2^n (up to MQTT_RECONNECT_MAX) + up to 25% jitter
+  failedAttempts++;
+  unsigned long backoff = MQTT_RECONNECT_MIN;
+  for (unsigned int i=1;i<failedAttempts && backoff<MQTT_RECONNECT_MAX;i++)
+    backoff *= 2;
+  if (backoff > MQTT_RECONNECT_MAX)
+    backoff = MQTT_RECONNECT_MAX;
+  reconnectDelay = backoff + random(backoff/4 + 1);
+  lastAttempt = millis();
+  sendToDebug(String("*IR: Next MQTT connect attempt in ") + reconnectDelay + " ms\n");
 }
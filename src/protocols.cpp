@@ -0,0 +1,204 @@
+#include "globals.h"
+
+/*
+ * Protocol registry
+ *
+ * One entry for every decode_type_t of IRremoteESP8266 in enum order, so
+ * protocol of decoded code is found by index. Protocol names (used in
+ * receiver and sender topics) are found with open addressing hash index.
+ * Protocols with single value senders have send function and default
+ * number of bits, sender is NULL if it is disabled in library (SEND_*)
+ * or protocol needs state array (A/C units).
+ */
+
+#if SEND_RC5
+static void sendRC5(uint64_t value, uint16_t bits)         { irsend.sendRC5(value, bits); }
+#else
+#define sendRC5 NULL
+#endif
+#if SEND_RC6
+static void sendRC6(uint64_t value, uint16_t bits)         { irsend.sendRC6(value, bits); }
+#else
+#define sendRC6 NULL
+#endif
+#if SEND_NEC
+static void sendNEC(uint64_t value, uint16_t bits)         { irsend.sendNEC(value, bits); }
+#else
+#define sendNEC NULL
+#endif
+#if SEND_SONY
+static void sendSony(uint64_t value, uint16_t bits)        { irsend.sendSony(value, bits); }
+#else
+#define sendSony NULL
+#endif
+#if SEND_PANASONIC
+static void sendPanasonic(uint64_t value, uint16_t bits)   { irsend.sendPanasonic64(value, bits); }
+#else
+#define sendPanasonic NULL
+#endif
+#if SEND_JVC
+static void sendJVC(uint64_t value, uint16_t bits)         { irsend.sendJVC(value, bits); }
+#else
+#define sendJVC NULL
+#endif
+#if SEND_SAMSUNG
+static void sendSamsung(uint64_t value, uint16_t bits)     { irsend.sendSAMSUNG(value, bits); }
+#else
+#define sendSamsung NULL
+#endif
+#if SEND_WHYNTER
+static void sendWhynter(uint64_t value, uint16_t bits)     { irsend.sendWhynter(value, bits); }
+#else
+#define sendWhynter NULL
+#endif
+#if SEND_AIWA_RC_T501
+static void sendAiwa(uint64_t value, uint16_t bits)        { irsend.sendAiwaRCT501(value, bits); }
+#else
+#define sendAiwa NULL
+#endif
+#if SEND_LG
+static void sendLG(uint64_t value, uint16_t bits)          { irsend.sendLG(value, bits); }
+#else
+#define sendLG NULL
+#endif
+#if SEND_MITSUBISHI
+static void sendMitsubishi(uint64_t value, uint16_t bits)  { irsend.sendMitsubishi(value, bits); }
+#else
+#define sendMitsubishi NULL
+#endif
+#if SEND_DISH
+static void sendDish(uint64_t value, uint16_t bits)        { irsend.sendDISH(value, bits); }
+#else
+#define sendDish NULL
+#endif
+#if SEND_SHARP
+static void sendSharp(uint64_t value, uint16_t bits)       { irsend.sendSharpRaw(value, bits); }
+#else
+#define sendSharp NULL
+#endif
+#if SEND_COOLIX
+static void sendCoolix(uint64_t value, uint16_t bits)      { irsend.sendCOOLIX(value, bits); }
+#else
+#define sendCoolix NULL
+#endif
+#if SEND_DENON
+static void sendDenon(uint64_t value, uint16_t bits)       { irsend.sendDenon(value, bits); }
+#else
+#define sendDenon NULL
+#endif
+#if SEND_SHERWOOD
+static void sendSherwood(uint64_t value, uint16_t bits)    { irsend.sendSherwood(value, bits); }
+#else
+#define sendSherwood NULL
+#endif
+#if SEND_RCMM
+static void sendRCMM(uint64_t value, uint16_t bits)        { irsend.sendRCMM(value, bits); }
+#else
+#define sendRCMM NULL
+#endif
+#if SEND_SANYO
+static void sendSanyoLC7461(uint64_t value, uint16_t bits) { irsend.sendSanyoLC7461(value, bits); }
+#else
+#define sendSanyoLC7461 NULL
+#endif
+#if SEND_NIKAI
+static void sendNikai(uint64_t value, uint16_t bits)       { irsend.sendNikai(value, bits); }
+#else
+#define sendNikai NULL
+#endif
+
+// Entries in decode_type_t order: name, sender, default bits
+#define IR_PROTOCOL(type, sender, bits) { #type, type, sender, bits }
+static constexpr IRProtocolStruct irProtocols[] = {
+  IR_PROTOCOL(UNKNOWN,       NULL,            0),
+  IR_PROTOCOL(UNUSED,        NULL,            0),
+  IR_PROTOCOL(RC5,           sendRC5,         12),
+  IR_PROTOCOL(RC6,           sendRC6,         20),
+  IR_PROTOCOL(NEC,           sendNEC,         32),
+  IR_PROTOCOL(SONY,          sendSony,        12),
+  IR_PROTOCOL(PANASONIC,     sendPanasonic,   48),
+  IR_PROTOCOL(JVC,           sendJVC,         16),
+  IR_PROTOCOL(SAMSUNG,       sendSamsung,     32),
+  IR_PROTOCOL(WHYNTER,       sendWhynter,     32),
+  IR_PROTOCOL(AIWA_RC_T501,  sendAiwa,        15),
+  IR_PROTOCOL(LG,            sendLG,          28),
+  IR_PROTOCOL(SANYO,         NULL,            0),
+  IR_PROTOCOL(MITSUBISHI,    sendMitsubishi,  16),
+  IR_PROTOCOL(DISH,          sendDish,        16),
+  IR_PROTOCOL(SHARP,         sendSharp,       15),
+  IR_PROTOCOL(COOLIX,        sendCoolix,      24),
+  IR_PROTOCOL(DAIKIN,        NULL,            0),
+  IR_PROTOCOL(DENON,         sendDenon,       14),
+  IR_PROTOCOL(KELVINATOR,    NULL,            0),
+  IR_PROTOCOL(SHERWOOD,      sendSherwood,    32),
+  IR_PROTOCOL(MITSUBISHI_AC, NULL,            0),
+  IR_PROTOCOL(RCMM,          sendRCMM,        24),
+  IR_PROTOCOL(SANYO_LC7461,  sendSanyoLC7461, 42),
+  IR_PROTOCOL(RC5X,          sendRC5,         13),
+  IR_PROTOCOL(GREE,          NULL,            0),
+  IR_PROTOCOL(PRONTO,        NULL,            0),
+  IR_PROTOCOL(NEC_LIKE,      sendNEC,         32),
+  IR_PROTOCOL(ARGO,          NULL,            0),
+  IR_PROTOCOL(TROTEC,        NULL,            0),
+  IR_PROTOCOL(NIKAI,         sendNikai,       24),
+};
+#define PROTOCOLS_NUMBER (sizeof(irProtocols)/sizeof(irProtocols[0]))
+#define PROTOCOL_EMPTY 0xFF
+
+/* **************************************************************
+ * Check at compile time that entry of every type is at index type+1
+ */
+static constexpr bool protocolsOrdered(unsigned int i)
+{
+  return i >= PROTOCOLS_NUMBER || ((int) irProtocols[i].type == (int) i-1 && protocolsOrdered(i+1));
+}
+static_assert(protocolsOrdered(0), "irProtocols[] must follow decode_type_t order");
+static_assert(PROTOCOLS_NUMBER*2 <= PROTOCOL_INDEX_SIZE, "PROTOCOL_INDEX_SIZE too small");
+static_assert((PROTOCOL_INDEX_SIZE & (PROTOCOL_INDEX_SIZE-1)) == 0, "PROTOCOL_INDEX_SIZE must be power of 2");
+
+static uint8_t protocolIndex[PROTOCOL_INDEX_SIZE]; // hash -> irProtocols[] index
+static bool protocolIndexReady = false;
+
+/* **************************************************************
+ * Build open addressing hash index of protocol names
+ */
+static void buildProtocolIndex()
+{
+  memset(protocolIndex, PROTOCOL_EMPTY, sizeof(protocolIndex));
+  for (uint8_t i=0;i<PROTOCOLS_NUMBER;i++)
+  {
+    uint32_t pos = strHash(irProtocols[i].name);
+    while (protocolIndex[pos & (PROTOCOL_INDEX_SIZE-1)] != PROTOCOL_EMPTY)
+      pos++;
+    protocolIndex[pos & (PROTOCOL_INDEX_SIZE-1)] = i;
+  }
+  protocolIndexReady = true;
+}
+
+/* **************************************************************
+ * Protocol of decode type
+ */
+const IRProtocolStruct &irProtocol(decode_type_t type)
+{
+  unsigned int idx = (int) type + 1;
+  return idx < PROTOCOLS_NUMBER ? irProtocols[idx] : irProtocols[0];
+}
+
+/* **************************************************************
+ * Find protocol by name
+ * @returns NULL if there is no protocol with given name
+ */
+const IRProtocolStruct *irProtocolFind(const char *name)
+{
+  if (!protocolIndexReady)
+    buildProtocolIndex();
+  uint32_t pos = strHash(name);
+  uint8_t idx;
+  while ((idx = protocolIndex[pos & (PROTOCOL_INDEX_SIZE-1)]) != PROTOCOL_EMPTY)
+  {
+    if (strcmp(irProtocols[idx].name, name)==0)
+      return &irProtocols[idx];
+    pos++;
+  }
+  return NULL;
+}
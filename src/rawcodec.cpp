@@ -0,0 +1,193 @@
+#include "globals.h"
+
+/*
+ * Compact binary encoding of raw codes (receiver/rawb, sender/sendRAWb)
+ *
+ * Message is base64 of byte stream:
+ *  - varint - frequency in kHz (0 - unknown)
+ *  - varint(zigzag(q[i] - q[i-2])) for every duration, where q[i] is duration
+ *    in RAWTICK units and q[-1] = q[-2] = 0 (marks are compared with marks,
+ *    spaces with spaces)
+ * Varint is 7 bits per byte, least significant group first, bit 7 set when
+ * next byte follows.
+ */
+
+static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* **************************************************************
+ * Zigzag encoding of difference between durations
+ */
+static uint32_t zigzagDelta(uint16_t value, uint16_t previous)
+{
+  int32_t delta = (int32_t) value - previous;
+  return ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+}
+
+/* **************************************************************
+ * Number of bytes of varint
+ */
+static uint8_t varintSize(uint32_t value)
+{
+  uint8_t size = 1;
+  while (value >= 0x80)
+  {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+/* **************************************************************
+ * Base64 stream writer
+ */
+struct Base64WriterStruct {
+  Print *out;
+  uint8_t in[3];
+  uint8_t inLen;
+  char buf[64];
+  uint8_t bufLen;
+};
+
+static void base64Flush(Base64WriterStruct &w)
+{
+  if (w.inLen > 0)
+  {
+    uint32_t triple = ((uint32_t) w.in[0] << 16) | ((uint32_t) (w.inLen > 1 ? w.in[1] : 0) << 8) | (w.inLen > 2 ? w.in[2] : 0);
+    w.buf[w.bufLen++] = base64Chars[(triple >> 18) & 0x3F];
+    w.buf[w.bufLen++] = base64Chars[(triple >> 12) & 0x3F];
+    w.buf[w.bufLen++] = w.inLen > 1 ? base64Chars[(triple >> 6) & 0x3F] : '=';
+    w.buf[w.bufLen++] = w.inLen > 2 ? base64Chars[triple & 0x3F] : '=';
+    w.inLen = 0;
+  }
+  if (w.bufLen > sizeof(w.buf)-4)
+  {
+    w.out->write((const uint8_t *) w.buf, w.bufLen);
+    w.bufLen = 0;
+  }
+}
+
+static void base64WriteVarint(Base64WriterStruct &w, uint32_t value)
+{
+  do
+  {
+    uint8_t b = value & 0x7F;
+    value >>= 7;
+    w.in[w.inLen++] = value ? (b | 0x80) : b;
+    if (w.inLen == 3)
+      base64Flush(w);
+  } while (value);
+}
+
+/* **************************************************************
+ * Length of encoded message
+ * - rawbuf - durations in RAWTICK units, rawlen - number of durations
+ * - freq - frequency in kHz (0 - unknown)
+ */
+unsigned int rawBinaryLength(const volatile uint16_t *rawbuf, uint16_t rawlen, uint16_t freq)
+{
+  unsigned int bytes = varintSize(freq);
+  for (uint16_t i=0;i<rawlen;i++)
+  {
+    bytes += varintSize(zigzagDelta(rawbuf[i], i>=2 ? rawbuf[i-2] : 0));
+  }
+  return (bytes+2)/3*4;
+}
+
+/* **************************************************************
+ * Write encoded message to stream (rawBinaryLength() chars)
+ * - out - destination stream
+ * - rawbuf - durations in RAWTICK units, rawlen - number of durations
+ * - freq - frequency in kHz (0 - unknown)
+ */
+void writeRawBinary(Print &out, const volatile uint16_t *rawbuf, uint16_t rawlen, uint16_t freq)
+{
+  Base64WriterStruct w;
+  w.out = &out;
+  w.inLen = 0;
+  w.bufLen = 0;
+  base64WriteVarint(w, freq);
+  for (uint16_t i=0;i<rawlen;i++)
+  {
+    base64WriteVarint(w, zigzagDelta(rawbuf[i], i>=2 ? rawbuf[i-2] : 0));
+  }
+  base64Flush(w);
+  if (w.bufLen > 0)
+    out.write((const uint8_t *) w.buf, w.bufLen);
+}
+
+/* **************************************************************
+ * Value of base64 char, -1 if char is not allowed
+ */
+static int base64Value(byte c)
+{
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+/* **************************************************************
+ * Decode message directly from MQTT payload
+ * - payload - message content, length - message length
+ * - destinationArray[] - destination for durations in microseconds
+ * - maxElements - size of destinationArray
+ * - freq - destination for frequency in kHz (0 - unknown)
+ * @returns
+ * - -1 - wrong format
+ * - -2 - too many elements
+ * -  n - number of durations
+ */
+int decodeRawBinary(const byte* payload, unsigned int length, uint16_t destinationArray[], int maxElements, uint16_t *freq)
+{
+  uint32_t bits = 0;
+  uint8_t bitsNo = 0;
+  uint32_t value = 0;
+  uint8_t shift = 0;
+  int elementIdx = -1; // -1 - frequency
+  for (unsigned int i=0;i<length;i++)
+  {
+    if (payload[i] == '=')
+      break;
+    int v = base64Value(payload[i]);
+    if (v < 0)
+      return -1;
+    bits = (bits << 6) | v;
+    bitsNo += 6;
+    if (bitsNo < 8)
+      continue;
+    bitsNo -= 8;
+    uint8_t b = (bits >> bitsNo) & 0xFF;
+    if (shift > 28)
+      return -1;
+    value |= (uint32_t) (b & 0x7F) << shift;
+    shift += 7;
+    if (b & 0x80)
+      continue;
+    // Complete varint
+    if (elementIdx == -1)
+    {
+      if (value > 0xFFFF)
+        return -1;
+      *freq = value;
+    }
+    else
+    {
+      if (elementIdx >= maxElements)
+        return -2;
+      int32_t previous = elementIdx>=2 ? destinationArray[elementIdx-2] / RAWTICK : 0;
+      int32_t delta = (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+      int32_t ticks = previous + delta;
+      if (ticks < 0 || ticks * RAWTICK > 0xFFFF)
+        return -1;
+      destinationArray[elementIdx] = ticks * RAWTICK;
+    }
+    elementIdx++;
+    value = 0;
+    shift = 0;
+  }
+  if (shift != 0 || elementIdx < 0)
+    return -1;
+  return elementIdx;
+}
@@ -0,0 +1,164 @@
+#include "globals.h"
+
+/*
+ * IR capture pipeline
+ *
+ * Producer - rxCapturePoll() takes completed capture from receiver, copies
+ * it into ring of RX_RING_SIZE entries and resumes receiver at once. It is
+ * called from loop(), Ticker only marks every RX_POLL_PERIOD ms that poll
+ * is due (timer context does no decoding or copying). Receiver keeps
+ * completed capture until it is polled.
+ * Consumer - rxCaptureLoop() publishes captures from ring (topic, repeat
+ * coalescing, slot matching, raw dump). Captures wait in ring while broker
+ * is not connected. Ring has single producer and single consumer, each
+ * index is written only by its side.
+ */
+
+static RxCaptureStruct (&rxRing)[RX_RING_SIZE] = arena.rxRing;
+static volatile uint8_t rxRingHead = 0; // next entry to write (producer)
+static volatile uint8_t rxRingTail = 0; // next entry to read (consumer)
+static volatile bool rxPollDue = false; // set by rxTicker
+static Ticker rxTicker;
+
+static unsigned long rxCaptured = 0;
+static unsigned long rxDropped = 0;     // ring full
+static unsigned long rxOverflows = 0;   // capture longer than RX_CAPTURE_SIZE
+static uint8_t rxMaxDepth = 0;
+
+static_assert((RX_RING_SIZE & (RX_RING_SIZE-1)) == 0 && RX_RING_SIZE < 256, "RX_RING_SIZE must be power of 2");
+static_assert(RX_CAPTURE_SIZE-1 <= SLOT_SIZE, "Captured code must fit into slot");
+
+/* **************************************************************
+ * Mark that receiver should be polled, called from rxTicker
+ */
+static void rxCaptureTick()
+{
+  rxPollDue = true;
+}
+
+/* **************************************************************
+ * Take completed capture from receiver into ring, called from loop()
+ */
+void rxCapturePoll()
+{
+  if (!rxPollDue)
+    return;
+  rxPollDue = false;
+  decode_results results;
+  if (irrecv.decode(&results))
+  {
+    rxCaptured++;
+    if (results.overflow)
+      rxOverflows++;
+    uint8_t depth = rxRingHead - rxRingTail;
+    if (depth >= RX_RING_SIZE)
+    {
+      rxDropped++;
+    }
+    else
+    {
+      RxCaptureStruct &entry = rxRing[rxRingHead & (RX_RING_SIZE-1)];
+      entry.results = results;
+      entry.captured = millis();
+      entry.capturedUs = micros();
+      if (results.decode_type == UNKNOWN)
+      {
+        entry.results.rawlen = results.rawlen < RX_CAPTURE_SIZE ? results.rawlen : RX_CAPTURE_SIZE;
+        for (uint16_t i=0;i<entry.results.rawlen;i++)
+          entry.rawbuf[i] = results.rawbuf[i];
+      }
+      else
+      {
+        entry.results.rawlen = 0;
+      }
+      rxRingHead++;
+      if (depth+1 > rxMaxDepth)
+        rxMaxDepth = depth+1;
+    }
+    irrecv.resume();              // Prepare for the next value
+  }
+}
+
+/* **************************************************************
+ * Start receiver and periodic polling, called from setup()
+ */
+void rxCaptureBegin()
+{
+  irrecv.enableIRIn();  // Start the receiver
+  rxTicker.attach_ms(RX_POLL_PERIOD, rxCaptureTick);
+}
+
+/* **************************************************************
+ * Publish single capture
+ */
+static void rxPublish(RxCaptureStruct &entry)
+{
+  decode_results &results = entry.results;
+  results.rawbuf = entry.rawbuf;
+  char myValue[24];
+  int slotNo;
+  if (results.decode_type != UNKNOWN)
+  {
+    // any other has code and bits, repeats are coalesced
+    const char *myTopic = getReceiverTopic(&results);
+    if (rxFilterCode(&results, myTopic, entry.captured) && rxRateAllow(myTopic))
+    {
+      uint64ToStr(results.value, myValue);
+      mqttClient.publish(myTopic, myValue);
+    }
+  }
+  else if ((slotNo = rxMatchSlot(results.rawbuf, results.rawlen)) > 0)
+  {
+    // Unknown code of stored slot
+    const char *myTopic = getSlotTopic(slotNo);
+    if (rxRateAllow(myTopic))
+    {
+      myValue[uintToStr(slotNo, myValue)] = '\0';
+      mqttClient.publish(myTopic, myValue);
+    }
+  }
+  else if (rawMode==true)
+  {
+    // RAW MODE
+    if (rawBinary)
+    {
+      if (rxRateAllow(getTopic(TOPIC_RECEIVER_RAWB)))
+        publishRawBinary(getTopic(TOPIC_RECEIVER_RAWB), results.rawbuf, results.rawlen);
+    }
+    else
+    {
+      if (rxRateAllow(getTopic(TOPIC_RECEIVER_RAW)))
+        publishRawDurations(getTopic(TOPIC_RECEIVER_RAW), results.rawbuf, results.rawlen);
+    }
+  }
+  metricAdd(METRIC_RX, micros() - entry.capturedUs);
+}
+
+/* **************************************************************
+ * Publish oldest capture from ring, called from loop()
+ */
+void rxCaptureLoop()
+{
+  if (rxRingTail == rxRingHead || !mqttClient.connected())
+    return;
+  rxPublish(rxRing[rxRingTail & (RX_RING_SIZE-1)]);
+  rxRingTail++;
+}
+
+/* **************************************************************
+ * Capture statistics for cmd topic
+ */
+String rxCaptureInfo()
+{
+  String result = "Captured=";
+  result += rxCaptured;
+  result += ";Waiting=";
+  result += (uint8_t) (rxRingHead - rxRingTail);
+  result += ";Max depth=";
+  result += rxMaxDepth;
+  result += ";Dropped=";
+  result += rxDropped;
+  result += ";Overflows=";
+  result += rxOverflows;
+  return result;
+}
@@ -0,0 +1,180 @@
+#include "globals.h"
+
+/*
+ * Receiver filter
+ *
+ * Repeat coalescing - first frame of a button press is published at once.
+ * Following identical frames (and NEC repeat codes) which come within
+ * RX_REPEAT_WINDOW ms after previous one are only counted. When button is
+ * released (no repeat within window) single summary with number of repeats
+ * and hold duration is published on _receiver_topic_/repeat.
+ *
+ * Rate limiting - every receiver topic has token bucket (RX_RATE messages
+ * per second, up to RX_BURST at once), messages without token are dropped.
+ * Buckets of RX_BUCKETS most recently used topics are kept.
+ */
+
+struct RxBucketStruct {
+  uint32_t topicHash;
+  uint32_t tokens;           // 1/1000 of message
+  unsigned long lastRefill;  // millis()
+};
+
+static RxBucketStruct rxBuckets[RX_BUCKETS];
+static uint8_t rxBucketsNo = 0;
+
+static bool rxActive = false;             // press in progress
+static char rxActiveTopic[TOPIC_SIZE];
+static decode_type_t rxActiveType;
+static uint16_t rxActiveBits;
+static uint64_t rxActiveValue;
+static uint32_t rxActiveAddress;
+static unsigned long rxActiveStart = 0;   // first frame (millis)
+static unsigned long rxActiveLast = 0;    // last frame (millis)
+static unsigned long rxActiveRepeats = 0;
+
+static unsigned long rxCoalesced = 0;
+static unsigned long rxLimited = 0;
+
+/* **************************************************************
+ * Check if frame is NEC repeat code (no data, only "button still pressed")
+ */
+static bool rxIsRepeatCode(const decode_results *results)
+{
+  return results->decode_type == NEC && results->bits == 0;
+}
+
+/* **************************************************************
+ * Publish summary of finished press with repeats
+ */
+static void rxPublishRepeats()
+{
+  if (rxActiveRepeats == 0 || !mqttClient.connected())
+    return;
+  char myTopic[TOPIC_SIZE+sizeof("/repeat")];
+  char myValue[24];
+  sprintf(myTopic, "%s/repeat", rxActiveTopic);
+  uint64ToStr(rxActiveValue, myValue);
+  String message = String("Value=")+myValue+";Repeats="+rxActiveRepeats+";Hold="+(rxActiveLast-rxActiveStart);
+  mqttClient.publish(myTopic, message.c_str());
+}
+
+/* **************************************************************
+ * Coalesce repeated frames
+ * - results - decoded frame
+ * - topic - receiver topic of frame
+ * - now - time of capture (millis)
+ * @returns true if frame should be published, false for repeat
+ */
+bool rxFilterCode(const decode_results *results, const char *topic, unsigned long now)
+{
+  if (rxActive && now - rxActiveLast <= RX_REPEAT_WINDOW)
+  {
+    bool same = results->decode_type == rxActiveType && results->bits == rxActiveBits
+                && results->value == rxActiveValue && results->address == rxActiveAddress;
+    if (same || (rxIsRepeatCode(results) && rxActiveType == NEC))
+    {
+      rxActiveLast = now;
+      rxActiveRepeats++;
+      rxCoalesced++;
+      return false;
+    }
+  }
+  if (rxActive)
+  {
+    rxPublishRepeats();
+  }
+  rxActive = true;
+  strncpy(rxActiveTopic, topic, sizeof(rxActiveTopic)-1);
+  rxActiveTopic[sizeof(rxActiveTopic)-1] = '\0';
+  rxActiveType = results->decode_type;
+  rxActiveBits = results->bits;
+  rxActiveValue = results->value;
+  rxActiveAddress = results->address;
+  rxActiveStart = now;
+  rxActiveLast = now;
+  rxActiveRepeats = 0;
+  return true;
+}
+
+/* **************************************************************
+ * Publish summary when press is finished, called from loop()
+ */
+void rxFilterLoop()
+{
+  if (rxActive && millis() - rxActiveLast > RX_REPEAT_WINDOW)
+  {
+    rxPublishRepeats();
+    rxActive = false;
+  }
+}
+
+/* **************************************************************
+ * Token bucket rate limiter
+ * @returns true if message on topic can be published
+ */
+bool rxRateAllow(const char *topic)
+{
+  uint32_t hash = strHash(topic);
+  unsigned long now = millis();
+  int idx = -1;
+  for (uint8_t i=0;i<rxBucketsNo;i++)
+  {
+    if (rxBuckets[i].topicHash == hash)
+    {
+      idx = i;
+      break;
+    }
+  }
+  if (idx == -1)
+  {
+    // New topic - full bucket in free or least recently used place
+    if (rxBucketsNo < RX_BUCKETS)
+    {
+      idx = rxBucketsNo++;
+    }
+    else
+    {
+      idx = 0;
+      for (uint8_t i=1;i<RX_BUCKETS;i++)
+      {
+        if (rxBuckets[i].lastRefill < rxBuckets[idx].lastRefill)
+          idx = i;
+      }
+    }
+    rxBuckets[idx].topicHash = hash;
+    rxBuckets[idx].tokens = RX_BURST*1000UL;
+  }
+  else
+  {
+    unsigned long elapsed = now - rxBuckets[idx].lastRefill;
+    uint32_t tokens = elapsed < RX_BURST*1000UL ? rxBuckets[idx].tokens + elapsed * RX_RATE : RX_BURST*1000UL;
+    rxBuckets[idx].tokens = tokens < RX_BURST*1000UL ? tokens : RX_BURST*1000UL;
+  }
+  rxBuckets[idx].lastRefill = now;
+  if (rxBuckets[idx].tokens < 1000)
+  {
+    rxLimited++;
+    return false;
+  }
+  rxBuckets[idx].tokens -= 1000;
+  return true;
+}
+
+/* **************************************************************
+ * Filter statistics for cmd topic
+ */
+String rxFilterInfo()
+{
+  String result = "Coalesced=";
+  result += rxCoalesced;
+  result += ";Rate limited=";
+  result += rxLimited;
+  result += ";Window=";
+  result += RX_REPEAT_WINDOW;
+  result += ";Rate=";
+  result += RX_RATE;
+  result += ";Burst=";
+  result += RX_BURST;
+  return result;
+}
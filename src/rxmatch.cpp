@@ -0,0 +1,170 @@
+#include "globals.h"
+
+/*
+ * Matching of unknown captures against stored slots
+ *
+ * Every slot has signature - number of durations and hash of duration
+ * classes (short/long, separately for marks and spaces, relative to the
+ * shortest one) of all but the last RX_MATCH_LENGTH_DIFF durations.
+ * Signature is computed when slot is written and kept in slot database
+ * index, slotDbLoadIndex() passes signatures of all slots here. Capture
+ * is compared in full only with slots of the same signature, for them
+ * every duration must be within RX_MATCH_TOLERANCE % (at least
+ * RX_MATCH_MIN_TOLERANCE us). Slot with the lowest average difference wins.
+ * Cached slots are transmit programs, transmitter compensation is removed
+ * before comparison.
+ */
+
+struct RxSignatureStruct {
+  uint16_t count;  // number of durations, 0 - empty slot or too short code
+  uint32_t hash;   // hash of duration classes
+};
+
+static RxSignatureStruct rxSignatures[SLOTS_NUMBER];
+
+static unsigned long rxMatched = 0;
+static unsigned long rxCompared = 0;
+
+/* **************************************************************
+ * Hash of duration classes of first length durations - duration is long
+ * when it is at least RX_MATCH_LONG/4 times the shortest one of its kind
+ * (mark/space), so jitter within tolerance doesn't change hash
+ */
+template <typename T>
+static uint32_t rxMatchHash(const T durations[], int length, uint16_t multiplier)
+{
+  uint32_t shortest[2] = { 0xFFFFFFFF, 0xFFFFFFFF };
+  for (int i=0;i<length;i++)
+  {
+    uint32_t value = durations[i] * multiplier;
+    if (value < shortest[i & 1])
+      shortest[i & 1] = value;
+  }
+  uint32_t hash = 2166136261UL; // FNV-1a
+  for (int i=0;i<length;i++)
+  {
+    uint32_t value = durations[i] * multiplier;
+    hash = (hash ^ (4*value >= RX_MATCH_LONG*shortest[i & 1] ? 1 : 0)) * 16777619UL;
+  }
+  return hash;
+}
+
+/* **************************************************************
+ * Check if values differ at most by tolerance
+ */
+static bool rxMatchWithin(uint32_t a, uint32_t b, uint32_t percent, uint32_t minimum)
+{
+  uint32_t larger = a > b ? a : b;
+  uint32_t diff = a > b ? a - b : b - a;
+  uint32_t tolerance = larger * percent / 100;
+  return diff <= (tolerance > minimum ? tolerance : minimum);
+}
+
+/* **************************************************************
+ * Compute signature of slot (when it is written)
+ * - durations[] - durations of slot (without frequency), count - their number
+ * - sigCount, sigHash - signature for slot database index
+ */
+void rxMatchSignature(const uint16_t durations[], int count, uint16_t &sigCount, uint32_t &sigHash)
+{
+  if (count < RX_MATCH_MIN_LENGTH)
+  {
+    sigCount = 0;
+    sigHash = 0;
+    return;
+  }
+  sigCount = count;
+  sigHash = rxMatchHash(durations, count-RX_MATCH_LENGTH_DIFF, 1);
+}
+
+/* **************************************************************
+ * Set signature of slot (from slot database index)
+ */
+void rxMatchSetSignature(int slotNo, uint16_t sigCount, uint32_t sigHash)
+{
+  if (slotNo>=1 && slotNo<=SLOTS_NUMBER)
+  {
+    rxSignatures[slotNo-1].count = sigCount;
+    rxSignatures[slotNo-1].hash = sigHash;
+  }
+}
+
+/* **************************************************************
+ * Average difference of capture and slot in % of duration
+ * @returns -1 if any duration is out of tolerance
+ */
+static int rxMatchDistance(const volatile uint16_t capture[], const uint16_t slot[], int count)
+{
+  uint32_t distance = 0;
+  for (int i=0;i<count;i++)
+  {
+    uint32_t a = capture[i] * RAWTICK;
+    int32_t source = (int32_t) slot[i] - txAdjustment(i);
+    uint32_t b = source > 0 ? source : 1;
+    if (!rxMatchWithin(a, b, RX_MATCH_TOLERANCE, RX_MATCH_MIN_TOLERANCE))
+      return -1;
+    uint32_t larger = a > b ? a : b;
+    distance += (a > b ? a - b : b - a) * 100 / (larger ? larger : 1);
+  }
+  return distance / count;
+}
+
+/* **************************************************************
+ * Find stored slot with the same code as capture
+ * - rawbuf - raw buffer of IRrecv (first element is not a duration)
+ * - rawlen - number of elements in rawbuf
+ * @returns slot number, 0 - no matching slot
+ */
+int rxMatchSlot(const volatile uint16_t *rawbuf, uint16_t rawlen)
+{
+  if (rawlen < RX_MATCH_MIN_LENGTH+1)
+    return 0;
+  const volatile uint16_t *capture = rawbuf+1;
+  int count = rawlen-1;
+  // Receiver may miss trailing durations - slot of n durations has hash of
+  // n-RX_MATCH_LENGTH_DIFF ones, hashes of capture for all possible n
+  uint32_t hashes[2*RX_MATCH_LENGTH_DIFF+1];
+  int shortest = count-2*RX_MATCH_LENGTH_DIFF;
+  for (int i=0;i<=2*RX_MATCH_LENGTH_DIFF;i++)
+  {
+    hashes[i] = shortest+i > 0 ? rxMatchHash(capture, shortest+i, RAWTICK) : 0;
+  }
+  int bestSlot = 0;
+  int bestDistance = 0;
+  for (int slotNo=1;slotNo<=SLOTS_NUMBER;slotNo++)
+  {
+    const RxSignatureStruct &signature = rxSignatures[slotNo-1];
+    if (signature.count == 0
+        || signature.count + RX_MATCH_LENGTH_DIFF < count || count + RX_MATCH_LENGTH_DIFF < signature.count
+        || hashes[signature.count-RX_MATCH_LENGTH_DIFF-shortest] != signature.hash)
+      continue;
+    uint16_t *data;
+    int size = getSlotData(slotNo, &data);
+    if (size < 2)
+      continue;
+    rxCompared++;
+    int distance = rxMatchDistance(capture, data, count < size-1 ? count : size-1);
+    if (distance >= 0 && (bestSlot == 0 || distance < bestDistance))
+    {
+      bestSlot = slotNo;
+      bestDistance = distance;
+    }
+  }
+  if (bestSlot)
+    rxMatched++;
+  return bestSlot;
+}
+
+/* **************************************************************
+ * Matcher statistics for cmd topic
+ */
+String rxMatchInfo()
+{
+  String result = "Matched=";
+  result += rxMatched;
+  result += ";Compared=";
+  result += rxCompared;
+  result += ";Tolerance=";
+  result += RX_MATCH_TOLERANCE;
+  return result;
+}
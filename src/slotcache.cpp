@@ -0,0 +1,207 @@
+#include "globals.h"
+
+/*
+ * Decoded slots cache
+ *
+ * Slots are kept in a single pool of SLOT_CACHE_SIZE bytes, packed one after
+ * another in the order of cacheEntries[]. When a new slot does not fit, the
+ * least recently used entry is removed and the pool is compacted. Slots
+ * 1..SLOT_CACHE_PINNED (button and auto sender codes) and slots waiting in
+ * TX queue (macro steps) are never evicted. Missing slots are cached as
+ * empty entries, so repeated requests for them don't touch SPIFFS either
+ * (database errors are not cached). Slots are compiled into transmit
+ * programs (txProgramCompile) when they are loaded.
+ */
+
+struct SlotCacheEntryStruct {
+  uint16_t slotNo;
+  uint16_t offset;        // first element in cachePool
+  uint16_t size;          // number of elements (with frequency), 0 - empty slot
+  unsigned long lastUse;  // value of cacheTick on last access
+};
+
+static uint16_t (&cachePool)[SLOT_CACHE_SIZE/sizeof(uint16_t)] = arena.slotCache;
+static SlotCacheEntryStruct cacheEntries[SLOT_CACHE_ENTRIES];
+static int cacheEntriesNo = 0;
+static unsigned long cacheTick = 0;
+static unsigned long cacheHits = 0;
+static unsigned long cacheMisses = 0;
+
+/* **************************************************************
+ * Number of pool elements in use
+ */
+static uint16_t slotCacheUsed()
+{
+  if (cacheEntriesNo==0)
+    return 0;
+  SlotCacheEntryStruct &last = cacheEntries[cacheEntriesNo-1];
+  return last.offset + last.size;
+}
+
+/* **************************************************************
+ * Remove entry from cache and compact pool
+ * - idx - index in cacheEntries[]
+ */
+static void slotCacheRemove(int idx)
+{
+  uint16_t freed = cacheEntries[idx].size;
+  uint16_t used = slotCacheUsed();
+  uint16_t tail = cacheEntries[idx].offset + freed;
+  if (freed>0 && tail<used)
+  {
+    memmove(&cachePool[cacheEntries[idx].offset], &cachePool[tail], (used-tail)*sizeof(uint16_t));
+  }
+  for (int i=idx;i<cacheEntriesNo-1;i++)
+  {
+    cacheEntries[i] = cacheEntries[i+1];
+    cacheEntries[i].offset -= freed;
+  }
+  cacheEntriesNo--;
+}
+
+/* **************************************************************
+ * Remove least recently used entry which is not pinned
+ * @returns false if there is nothing to evict
+ */
+static bool slotCacheEvict()
+{
+  int victim = -1;
+  for (int i=0;i<cacheEntriesNo;i++)
+  {
+    if (cacheEntries[i].slotNo <= SLOT_CACHE_PINNED || txQueueHasSlot(cacheEntries[i].slotNo))
+      continue;
+    if (victim==-1 || cacheEntries[i].lastUse < cacheEntries[victim].lastUse)
+      victim = i;
+  }
+  if (victim==-1)
+    return false;
+  sendToDebug(String("*IR: cache evict slot ")+cacheEntries[victim].slotNo+"\n");
+  slotCacheRemove(victim);
+  return true;
+}
+
+/* **************************************************************
+ * Get slot data, from cache or from slot database
+ * - slotNo - slot number
+ * - data - pointer to slot elements (transmit program), last element is
+ *   frequency. It is valid until next call of cache functions.
+ * @returns number of elements (with frequency), 0 - slot empty or broken
+ */
+int getSlotData(int slotNo, uint16_t **data)
+{
+  cacheTick++;
+  for (int i=0;i<cacheEntriesNo;i++)
+  {
+    if (cacheEntries[i].slotNo == slotNo)
+    {
+      cacheHits++;
+      cacheEntries[i].lastUse = cacheTick;
+      *data = &cachePool[cacheEntries[i].offset];
+      return cacheEntries[i].size;
+    }
+  }
+  cacheMisses++;
+  int size = slotDbRead(slotNo, rawIrData);
+  if (size<-1)
+  {
+    // Database error or corrupted slot - not cached, next request tries again
+    *data = rawIrData;
+    return 0;
+  }
+  if (size<0)
+    size = 0;
+  if (size>1)
+    txProgramCompile(rawIrData, size-1);
+  *data = rawIrData;
+
+  const uint16_t capacity = sizeof(cachePool)/sizeof(uint16_t);
+  if (size>capacity)
+  {
+    // Never fits - use without caching
+    return size;
+  }
+  while (cacheEntriesNo==SLOT_CACHE_ENTRIES || capacity-slotCacheUsed()<size)
+  {
+    if (!slotCacheEvict())
+      return size;
+  }
+  SlotCacheEntryStruct &entry = cacheEntries[cacheEntriesNo];
+  entry.slotNo = slotNo;
+  entry.offset = slotCacheUsed();
+  entry.size = size;
+  entry.lastUse = cacheTick;
+  memcpy(&cachePool[entry.offset], rawIrData, size*sizeof(uint16_t));
+  cacheEntriesNo++;
+  *data = &cachePool[entry.offset];
+  return size;
+}
+
+/* **************************************************************
+ * Drop slot from cache (after slot change)
+ */
+void slotCacheInvalidate(int slotNo)
+{
+  for (int i=0;i<cacheEntriesNo;i++)
+  {
+    if (cacheEntries[i].slotNo == slotNo)
+    {
+      slotCacheRemove(i);
+      return;
+    }
+  }
+}
+
+/* **************************************************************
+ * Compile changed slot into cache right away, so the first transmit
+ * doesn't read slot database
+ */
+void slotCacheUpdate(int slotNo)
+{
+  slotCacheInvalidate(slotNo);
+  uint16_t *data;
+  getSlotData(slotNo, &data);
+}
+
+/* **************************************************************
+ * Drop all slots from cache (after change of compensation)
+ */
+void slotCacheClear()
+{
+  cacheEntriesNo = 0;
+}
+
+/* **************************************************************
+ * Transmit raw code from given slot
+ * @returns true if code was sent
+ */
+bool sendStoredSlot(int slotNo)
+{
+  if (slotNo<1 || slotNo>SLOTS_NUMBER)
+    return false;
+  uint16_t *data;
+  unsigned long start = micros();
+  int size = getSlotData(slotNo, &data);
+  metricAdd(METRIC_SLOT, micros() - start);
+  if (size<2)
+    return false;
+  txProgramEmit(data, size-1, data[size-1]);
+  return true;
+}
+
+/* **************************************************************
+ * Cache statistics for cmd topic
+ */
+String slotCacheInfo()
+{
+  String result = "Hits=";
+  result += cacheHits;
+  result += ";Misses=";
+  result += cacheMisses;
+  result += ";Slots=";
+  result += cacheEntriesNo;
+  result += ";Used bytes=";
+  result += (unsigned int) (slotCacheUsed()*sizeof(uint16_t));
+  result += ";Total bytes=";
+  result += (unsigned int) sizeof(cachePool);
+  return result;
+}
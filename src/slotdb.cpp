@@ -0,0 +1,692 @@
+#include "globals.h"
+
+/*
+ * Slot database
+ *
+ * All slots are kept in single SLOT_DB_FILE, which stays open:
+ *  - SlotDbHeaderStruct
+ *  - index - SLOTS_NUMBER SlotIndexStruct entries at fixed offsets
+ *  - records - SlotHeaderStruct + body, new record is always appended
+ *    after the last live one and then index entry is switched to it
+ * Any slot is reached by two seeks (index entry, record) instead of SPIFFS
+ * file lookups. Space of overwritten records is reclaimed by compaction
+ * into SLOT_DB_TMP_FILE when it exceeds SLOT_DB_GARBAGE bytes. Complete
+ * copy replaces database by renames (database -> SLOT_DB_OLD_FILE, copy ->
+ * database, old file removed), interrupted swap is finished when database
+ * is opened.
+ * Index updates are write-ahead journaled: record is written and flushed
+ * first, then index entry is appended to SLOT_DB_JOURNAL_FILE (and kept
+ * in RAM). Journal is written into index (checkpoint) when it is full,
+ * after SLOT_DB_CHECKPOINT_DELAY without changes and before compaction.
+ * Journal left by power loss is replayed when database is opened, torn
+ * last entry is ignored - old record stays valid. So slot is never lost
+ * by interrupted write and bulk writes append only, without rewriting
+ * index pages.
+ * Slot files of previous firmware (/ir/N.dat) are moved into the database
+ * when it is created. Database created with other SLOTS_NUMBER is moved
+ * into new layout, so is database of version 1 (index without receiver
+ * matcher signatures). Database which can't be read (other format, corrupted)
+ * is never removed automatically - error is reported by slotDbInfo() until
+ * slotDbReset() is requested.
+ */
+
+static_assert(sizeof(SlotIndexStruct) == 40, "SlotIndexStruct should have 40 bytes");
+static_assert(sizeof(SlotJournalStruct) == 44, "SlotJournalStruct should have 44 bytes");
+static_assert(sizeof(SlotHeaderStruct) % 2 == 0, "Packed body after SlotHeaderStruct must be aligned");
+
+// Index entry of database version 1
+struct SlotIndexV1Struct {
+  uint32_t offset;
+  uint16_t size;
+  char name[SLOT_NAME_SIZE];
+};
+static_assert(sizeof(SlotIndexV1Struct) == 32, "SlotIndexV1Struct should have 32 bytes");
+
+#define SLOT_DB_INDEX_POS sizeof(SlotDbHeaderStruct)
+#define SLOT_DB_DATA_POS (SLOT_DB_INDEX_POS + SLOTS_NUMBER*sizeof(SlotIndexStruct))
+
+static File dbFile;
+static bool dbReady = false;
+static const char *dbError = NULL;           // database can't be used (slotDbReset)
+static uint32_t dbDataEnd = SLOT_DB_DATA_POS; // end of last live record
+static uint32_t dbGarbage = 0;                // bytes of dead records
+static uint16_t dbNameHash[SLOTS_NUMBER];     // 0 - slot without name
+static File journalFile;
+static SlotJournalStruct journal[SLOT_DB_JOURNAL_SIZE]; // index updates not written into database yet
+static uint8_t journalNo = 0;
+static unsigned long journalTime = 0;         // millis() of last journal entry
+
+/* **************************************************************
+ * Hash of slot name (never 0)
+ */
+static uint16_t slotNameHash(const char *name)
+{
+  uint32_t hash = strHash(name);
+  uint16_t result = (hash >> 16) ^ (hash & 0xFFFF);
+  return result ? result : 1;
+}
+
+/* **************************************************************
+ * Read index entry of slot (the newest one from journal)
+ */
+static bool slotDbReadIndex(int slotNo, SlotIndexStruct &entry)
+{
+  for (int i=journalNo-1;i>=0;i--)
+  {
+    if (journal[i].slotNo == slotNo)
+    {
+      entry = journal[i].entry;
+      return true;
+    }
+  }
+  return dbFile.seek(SLOT_DB_INDEX_POS + (slotNo-1)*sizeof(SlotIndexStruct), SeekSet)
+         && dbFile.read((uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+}
+
+/* **************************************************************
+ * Write index entry directly into database file (not flushed)
+ */
+static bool slotDbPutIndex(int slotNo, const SlotIndexStruct &entry)
+{
+  return dbFile.seek(SLOT_DB_INDEX_POS + (slotNo-1)*sizeof(SlotIndexStruct), SeekSet)
+         && dbFile.write((const uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+}
+
+/* **************************************************************
+ * Size of index entry in database of given version
+ */
+static size_t slotDbEntrySize(uint8_t version)
+{
+  return version == 1 ? sizeof(SlotIndexV1Struct) : sizeof(SlotIndexStruct);
+}
+
+/* **************************************************************
+ * Write journal into index and remove it
+ */
+static bool slotDbCheckpoint()
+{
+  if (journalFile)
+    journalFile.close();
+  if (journalNo == 0)
+    return true;
+  bool result = true;
+  for (uint8_t i=0;i<journalNo && result;i++)
+  {
+    result = slotDbPutIndex(journal[i].slotNo, journal[i].entry);
+  }
+  dbFile.flush();
+  if (!result)
+  {
+    sendToDebug("*IR: Slot journal checkpoint failed\n");
+    return false; // journal file stays, it is replayed after restart
+  }
+  journalNo = 0;
+  SPIFFS.remove(SLOT_DB_JOURNAL_FILE);
+  return true;
+}
+
+/* **************************************************************
+ * Update index entry of slot - append it to journal
+ */
+static bool slotDbWriteIndex(int slotNo, const SlotIndexStruct &entry)
+{
+  if (journalNo >= SLOT_DB_JOURNAL_SIZE && !slotDbCheckpoint())
+    return false;
+  SlotJournalStruct &record = journal[journalNo];
+  record.entry = entry;
+  record.slotNo = slotNo;
+  record.checksum = slotChecksum((const uint16_t *) &record, offsetof(SlotJournalStruct, checksum)/2);
+  if (!journalFile)
+    journalFile = SPIFFS.open(SLOT_DB_JOURNAL_FILE, "a");
+  bool result = journalFile && journalFile.write((const uint8_t *) &record, sizeof(record)) == sizeof(record);
+  if (journalFile)
+    journalFile.flush();
+  if (!result)
+  {
+    slotDbCheckpoint(); // don't append after torn entry
+    return false;
+  }
+  journalNo++;
+  journalTime = millis();
+  return true;
+}
+
+/* **************************************************************
+ * Write index updates from journal left by interrupted session
+ * - header - header of database file (journal has index entries of its version)
+ */
+static void slotDbReplayJournal(const SlotDbHeaderStruct &header)
+{
+  File file = SPIFFS.open(SLOT_DB_JOURNAL_FILE, "r");
+  if (!file)
+    return;
+  // Journal entry: index entry, slotNo, checksum of both
+  size_t entrySize = slotDbEntrySize(header.version);
+  size_t recordSize = entrySize + 2*sizeof(uint16_t);
+  uint16_t record[sizeof(SlotJournalStruct)/2];
+  int replayed = 0;
+  while (file.read((uint8_t *) record, recordSize) == recordSize)
+  {
+    uint16_t slotNo = record[entrySize/2];
+    if (slotNo<1 || slotNo>header.slotsNo
+        || record[entrySize/2+1] != slotChecksum(record, entrySize/2+1))
+      break; // torn last entry
+    if (!dbFile.seek(SLOT_DB_INDEX_POS + (slotNo-1)*entrySize, SeekSet)
+        || dbFile.write((const uint8_t *) record, entrySize) != entrySize)
+      break;
+    replayed++;
+  }
+  file.close();
+  dbFile.flush();
+  SPIFFS.remove(SLOT_DB_JOURNAL_FILE);
+  sendToDebug(String("*IR: Slot journal replayed, entries: ")+replayed+"\n");
+}
+
+/* **************************************************************
+ * Create empty database file
+ */
+static bool slotDbCreate(const char *fName)
+{
+  File file = SPIFFS.open(fName, "w");
+  if (!file)
+    return false;
+  SlotDbHeaderStruct header;
+  header.magic = SLOT_DB_MAGIC;
+  header.version = SLOT_DB_VERSION;
+  header.reserved = 0;
+  header.slotsNo = SLOTS_NUMBER;
+  bool result = file.write((const uint8_t *) &header, sizeof(header)) == sizeof(header);
+  SlotIndexStruct entry;
+  memset(&entry, 0, sizeof(entry));
+  for (int i=0;i<SLOTS_NUMBER && result;i++)
+  {
+    result = file.write((const uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+  }
+  file.close();
+  return result;
+}
+
+/* **************************************************************
+ * Load index summary: end of data, garbage size, name hashes and receiver
+ * matcher signatures
+ */
+static bool slotDbLoadIndex()
+{
+  SlotIndexStruct entry;
+  uint32_t live = 0;
+  dbDataEnd = SLOT_DB_DATA_POS;
+  for (int slotNo=1;slotNo<=SLOTS_NUMBER;slotNo++)
+  {
+    if (!slotDbReadIndex(slotNo, entry))
+      return false;
+    entry.name[SLOT_NAME_SIZE-1] = '\0';
+    dbNameHash[slotNo-1] = entry.name[0] ? slotNameHash(entry.name) : 0;
+    rxMatchSetSignature(slotNo, entry.offset ? entry.sigCount : 0, entry.sigHash);
+    if (entry.offset == 0)
+      continue;
+    live += entry.size;
+    if (entry.offset + entry.size > dbDataEnd)
+      dbDataEnd = entry.offset + entry.size;
+  }
+  dbGarbage = dbDataEnd - SLOT_DB_DATA_POS - live;
+  return true;
+}
+
+/* **************************************************************
+ * Move slot files of previous firmware into database
+ */
+static void slotDbMigrate()
+{
+  char fName[20];
+  for (int slotNo=1;slotNo<=SLOTS_NUMBER;slotNo++)
+  {
+    sprintf(fName,"/ir/%d.dat",slotNo);
+    if (!SPIFFS.exists(fName))
+      continue;
+    sendToDebug(String("*IR: Moving slot file to database: ")+fName+"\n");
+    int size = readDataFile(fName, rawIrData);
+    if (size>0 && !slotDbWrite(slotNo, rawIrData, size))
+      continue; // keep file, next boot tries again
+    SPIFFS.remove(fName);
+  }
+}
+
+/* **************************************************************
+ * Read index entry of database of older version or other SLOTS_NUMBER,
+ * missing receiver matcher signature is computed from record
+ * - header - header of database file
+ */
+static bool slotDbReadSourceIndex(const SlotDbHeaderStruct &header, int slotNo, SlotIndexStruct &entry)
+{
+  if (header.version == SLOT_DB_VERSION)
+    return slotDbReadIndex(slotNo, entry);
+  SlotIndexV1Struct old;
+  if (!dbFile.seek(SLOT_DB_INDEX_POS + (slotNo-1)*sizeof(old), SeekSet)
+      || dbFile.read((uint8_t *) &old, sizeof(old)) != sizeof(old))
+    return false;
+  memset(&entry, 0, sizeof(entry));
+  entry.offset = old.offset;
+  entry.size = old.size;
+  memcpy(entry.name, old.name, sizeof(entry.name));
+  SlotHeaderStruct record;
+  if (entry.offset != 0 && slotNo <= SLOTS_NUMBER
+      && dbFile.seek(entry.offset, SeekSet)
+      && dbFile.read((uint8_t *) &record, sizeof(record)) == sizeof(record))
+  {
+    int size = decodeSlot(record, dbFile, rawIrData);
+    if (size > 1)
+      rxMatchSignature(rawIrData, size-1, entry.sigCount, entry.sigHash);
+  }
+  return true;
+}
+
+/* **************************************************************
+ * Copy live records into new file and replace database with it
+ * - header - header of current file (compaction: current version and
+ *   SLOTS_NUMBER, migration: older version or other SLOTS_NUMBER)
+ */
+static bool slotDbCopy(const SlotDbHeaderStruct &header)
+{
+  if (!slotDbCheckpoint() || !slotDbCreate(SLOT_DB_TMP_FILE))
+    return false;
+  File tmpFile = SPIFFS.open(SLOT_DB_TMP_FILE, "r+");
+  if (!tmpFile)
+    return false;
+  uint32_t position = SLOT_DB_DATA_POS;
+  bool result = true;
+  uint8_t buf[64];
+  SlotIndexStruct entry;
+  for (int slotNo=1;slotNo<=SLOTS_NUMBER && slotNo<=header.slotsNo && result;slotNo++)
+  {
+    result = slotDbReadSourceIndex(header, slotNo, entry);
+    if (!result || (entry.offset == 0 && entry.name[0] == '\0'))
+      continue;
+    uint32_t source = entry.offset;
+    if (entry.offset != 0)
+      entry.offset = position;
+    result = tmpFile.seek(SLOT_DB_INDEX_POS + (slotNo-1)*sizeof(SlotIndexStruct), SeekSet)
+             && tmpFile.write((const uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+    if (entry.offset == 0)
+      continue;
+    result = result && tmpFile.seek(position, SeekSet);
+    for (uint16_t done=0;done<entry.size && result;)
+    {
+      uint16_t chunk = entry.size-done < (int) sizeof(buf) ? entry.size-done : sizeof(buf);
+      result = dbFile.seek(source+done, SeekSet)
+               && dbFile.read(buf, chunk) == chunk
+               && tmpFile.write(buf, chunk) == chunk;
+      done += chunk;
+    }
+    position += entry.size;
+  }
+  tmpFile.close();
+  if (!result)
+  {
+    SPIFFS.remove(SLOT_DB_TMP_FILE);
+    return false;
+  }
+  dbFile.close();
+  SPIFFS.remove(SLOT_DB_OLD_FILE);
+  result = SPIFFS.rename(SLOT_DB_FILE, SLOT_DB_OLD_FILE);
+  if (result && !SPIFFS.rename(SLOT_DB_TMP_FILE, SLOT_DB_FILE))
+  {
+    // Keep the old database
+    SPIFFS.rename(SLOT_DB_OLD_FILE, SLOT_DB_FILE);
+    result = false;
+  }
+  if (result)
+    SPIFFS.remove(SLOT_DB_OLD_FILE);
+  else
+    SPIFFS.remove(SLOT_DB_TMP_FILE);
+  dbFile = SPIFFS.open(SLOT_DB_FILE, "r+");
+  if (!dbFile)
+  {
+    dbReady = false;
+    return false;
+  }
+  if (!result)
+  {
+    sendToDebug("*IR: Unable to replace slot database\n");
+    return false;
+  }
+  dbDataEnd = position;
+  dbGarbage = 0;
+  return true;
+}
+
+/* **************************************************************
+ * Finish replacement of database interrupted by power loss
+ */
+static void slotDbRecover()
+{
+  if (SPIFFS.exists(SLOT_DB_FILE))
+  {
+    // Copy wasn't complete or old file wasn't removed yet
+    SPIFFS.remove(SLOT_DB_TMP_FILE);
+    SPIFFS.remove(SLOT_DB_OLD_FILE);
+    return;
+  }
+  if (SPIFFS.exists(SLOT_DB_TMP_FILE))
+  {
+    // Complete copy (it is renamed only after it is closed)
+    sendToDebug("*IR: Finishing slot database replacement\n");
+    if (SPIFFS.rename(SLOT_DB_TMP_FILE, SLOT_DB_FILE))
+      SPIFFS.remove(SLOT_DB_OLD_FILE);
+  }
+  else if (SPIFFS.exists(SLOT_DB_OLD_FILE))
+  {
+    sendToDebug("*IR: Restoring slot database\n");
+    SPIFFS.rename(SLOT_DB_OLD_FILE, SLOT_DB_FILE);
+  }
+}
+
+/* **************************************************************
+ * Compact database - drop overwritten records
+ */
+static bool slotDbCompact()
+{
+  sendToDebug(String("*IR: Compacting slot database, garbage: ")+dbGarbage+"\n");
+  SlotDbHeaderStruct header;
+  header.version = SLOT_DB_VERSION;
+  header.slotsNo = SLOTS_NUMBER;
+  return slotDbCopy(header);
+}
+
+/* **************************************************************
+ * Database can't be used - it is kept untouched and error is reported
+ */
+static bool slotDbFail(const char *error)
+{
+  sendToDebug(String("*IR: ")+error+"\n");
+  dbFile.close();
+  dbError = error;
+  return false;
+}
+
+/* **************************************************************
+ * Move records of database of older version or created with other
+ * SLOTS_NUMBER into current layout, refused when codes are stored in
+ * slots which don't exist any more
+ */
+static bool slotDbUpgrade(const SlotDbHeaderStruct &header)
+{
+  SlotIndexStruct entry;
+  for (int slotNo=SLOTS_NUMBER+1;slotNo<=header.slotsNo;slotNo++)
+  {
+    if (!slotDbReadSourceIndex(header, slotNo, entry) || entry.offset != 0 || entry.name[0] != '\0')
+      return slotDbFail("Slot database has codes in slots over SLOTS_NUMBER");
+  }
+  sendToDebug(String("*IR: Moving slot database version ")+header.version+" with "+header.slotsNo+" slots\n");
+  if (!slotDbCopy(header))
+    return slotDbFail("Slot database migration failed");
+  return true;
+}
+
+/* **************************************************************
+ * Open database, create it if it is missing
+ */
+static bool slotDbOpen()
+{
+  if (dbReady)
+    return true;
+  if (dbError)
+    return false;
+  bool created = false;
+  slotDbRecover();
+  if (!SPIFFS.exists(SLOT_DB_FILE))
+  {
+    sendToDebug("*IR: Creating slot database\n");
+    if (!slotDbCreate(SLOT_DB_FILE))
+      return false;
+    created = true;
+  }
+  dbFile = SPIFFS.open(SLOT_DB_FILE, "r+");
+  if (!dbFile)
+  {
+    sendToDebug("*IR: Unable to open slot database\n");
+    return false;
+  }
+  SlotDbHeaderStruct header;
+  if (dbFile.read((uint8_t *) &header, sizeof(header)) != sizeof(header)
+      || header.magic != SLOT_DB_MAGIC || (header.version != SLOT_DB_VERSION && header.version != 1))
+  {
+    if (dbFile.size() > SLOT_DB_INDEX_POS)
+      return slotDbFail("Slot database from other firmware");
+    // Creation was interrupted - there are no codes
+    dbFile.close();
+    SPIFFS.remove(SLOT_DB_JOURNAL_FILE);
+    if (!slotDbCreate(SLOT_DB_FILE))
+      return false;
+    dbFile = SPIFFS.open(SLOT_DB_FILE, "r+");
+    if (!dbFile)
+      return false;
+    header.version = SLOT_DB_VERSION;
+    header.slotsNo = SLOTS_NUMBER;
+  }
+  slotDbReplayJournal(header);
+  if ((header.version != SLOT_DB_VERSION || header.slotsNo != SLOTS_NUMBER) && !slotDbUpgrade(header))
+    return false;
+  if (!slotDbLoadIndex())
+    return slotDbFail("Slot database corrupted");
+  dbReady = true;
+  if (created)
+    slotDbMigrate();
+  return true;
+}
+
+/* **************************************************************
+ * Read IR codes array from slot
+ * - slotNo - slot number (1..SLOTS_NUMBER)
+ * - destinationArray[] - destination for data from slot (SLOT_SIZE+1 elements),
+ *   last element is frequency
+ * @returns
+ * - -1 - slot is empty
+ * - -2 - problem with database
+ * - -3 - corrupted slot
+ * -  n - number of elements in slot
+ */
+int slotDbRead(int slotNo, uint16_t destinationArray[])
+{
+  if (slotNo<1 || slotNo>SLOTS_NUMBER)
+    return -1;
+  if (!slotDbOpen())
+    return -2;
+  SlotIndexStruct entry;
+  if (!slotDbReadIndex(slotNo, entry))
+    return -2;
+  if (entry.offset == 0)
+    return -1;
+  SlotHeaderStruct header;
+  if (!dbFile.seek(entry.offset, SeekSet)
+      || dbFile.read((uint8_t *) &header, sizeof(header)) != sizeof(header))
+    return -2;
+  int result = decodeSlot(header, dbFile, destinationArray);
+  if (result<0)
+  {
+    sendToDebug(String("*IR: Corrupted slot: ")+slotNo+"\n");
+  }
+  return result;
+}
+
+/* **************************************************************
+ * Write IR codes array to slot
+ * - slotNo - slot number (1..SLOTS_NUMBER)
+ * - sourceArray[] - source for data into slot, last element is frequency
+ * - sourceSize - number of elements in array
+ */
+bool slotDbWrite(int slotNo, const uint16_t sourceArray[], int sourceSize)
+{
+  if (sourceSize<1 || sourceSize>SLOT_SIZE+1)
+  {
+    sendToDebug(String("*IR: Wrong number of elements to write: ")+sourceSize+"\n");
+    return false;
+  }
+  if (slotNo<1 || slotNo>SLOTS_NUMBER || !slotDbOpen())
+    return false;
+  if (dbGarbage >= SLOT_DB_GARBAGE && !slotDbCompact())
+    return false;
+
+  // Packed body is encoded just after header, so record is written as one block
+  uint16_t record[(sizeof(SlotHeaderStruct)+SLOT_PACKED_MAX+1)/2];
+  SlotHeaderStruct header;
+  uint16_t *packed = record + sizeof(SlotHeaderStruct)/2;
+  const uint8_t *body;
+  size_t bodySize = encodeSlot(sourceArray, sourceSize, header, packed, &body);
+  SlotIndexStruct entry;
+  if (!slotDbReadIndex(slotNo, entry))
+    return false;
+  uint32_t oldSize = entry.offset ? entry.size : 0;
+
+  sendToDebug(String("*IR: Writing slot: ")+slotNo+" elements: "+header.count+" bytes: "+bodySize+"\n");
+  bool result = dbFile.seek(dbDataEnd, SeekSet);
+  if (body == (const uint8_t *) packed)
+  {
+    memcpy(record, &header, sizeof(header));
+    result = result && dbFile.write((const uint8_t *) record, sizeof(header)+bodySize) == sizeof(header)+bodySize;
+  }
+  else
+  {
+    result = result && dbFile.write((const uint8_t *) &header, sizeof(header)) == sizeof(header)
+             && dbFile.write(body, bodySize) == bodySize;
+  }
+  dbFile.flush();
+  if (result)
+  {
+    // Switch index to new record (record is on flash before journal entry)
+    entry.offset = dbDataEnd;
+    entry.size = sizeof(header) + bodySize;
+    rxMatchSignature(sourceArray, header.count, entry.sigCount, entry.sigHash);
+    result = slotDbWriteIndex(slotNo, entry);
+  }
+  if (!result)
+  {
+    sendToDebug("*IR: Writing failed\n");
+    return false;
+  }
+  dbDataEnd += entry.size;
+  dbGarbage += oldSize;
+  rxMatchSetSignature(slotNo, entry.sigCount, entry.sigHash);
+  return true;
+}
+
+/* **************************************************************
+ * Set name of slot
+ * - name - up to SLOT_NAME_SIZE-1 chars, not numeric, without ",*@=" (macro
+ *   syntax), "" removes name
+ * @returns false if name is wrong or used by other slot
+ */
+bool slotDbSetName(int slotNo, const char *name)
+{
+  size_t len = strlen(name);
+  if (slotNo<1 || slotNo>SLOTS_NUMBER || len>=SLOT_NAME_SIZE || !slotDbOpen())
+    return false;
+  if (len>0 && (isNumber(name) || strpbrk(name, ",*@=")!=NULL))
+    return false;
+  int owner = len>0 ? slotDbFind(name) : -1;
+  if (owner>0 && owner!=slotNo)
+    return false;
+  SlotIndexStruct entry;
+  if (!slotDbReadIndex(slotNo, entry))
+    return false;
+  memset(entry.name, 0, sizeof(entry.name));
+  memcpy(entry.name, name, len);
+  if (!slotDbWriteIndex(slotNo, entry))
+    return false;
+  dbNameHash[slotNo-1] = len>0 ? slotNameHash(name) : 0;
+  return true;
+}
+
+/* **************************************************************
+ * Find slot by name
+ * @returns slot number, -1 if there is no slot with given name
+ */
+int slotDbFind(const char *name)
+{
+  if (name[0] == '\0' || !slotDbOpen())
+    return -1;
+  uint16_t hash = slotNameHash(name);
+  SlotIndexStruct entry;
+  for (int slotNo=1;slotNo<=SLOTS_NUMBER;slotNo++)
+  {
+    if (dbNameHash[slotNo-1] != hash)
+      continue;
+    if (slotDbReadIndex(slotNo, entry) && strncmp(entry.name, name, SLOT_NAME_SIZE)==0)
+      return slotNo;
+  }
+  return -1;
+}
+
+/* **************************************************************
+ * Used slots for cmd topic: slot[:name]=bytes;...
+ */
+String slotDbInfo()
+{
+  if (!slotDbOpen())
+    return dbError ? String(dbError)+";Reset with cmd slotsreset" : String("Slot database error");
+  String result;
+  SlotIndexStruct entry;
+  int used = 0;
+  for (int slotNo=1;slotNo<=SLOTS_NUMBER;slotNo++)
+  {
+    if (!slotDbReadIndex(slotNo, entry) || (entry.offset == 0 && entry.name[0] == '\0'))
+      continue;
+    entry.name[SLOT_NAME_SIZE-1] = '\0';
+    result += slotNo;
+    if (entry.name[0])
+    {
+      result += ":";
+      result += entry.name;
+    }
+    result += "=";
+    result += entry.offset ? entry.size : 0;
+    result += ";";
+    if (entry.offset)
+      used++;
+  }
+  result += "Used slots=";
+  result += used;
+  result += ";Slots=";
+  result += SLOTS_NUMBER;
+  result += ";Data bytes=";
+  result += dbDataEnd;
+  result += ";Garbage bytes=";
+  result += dbGarbage;
+  result += ";Journal=";
+  result += journalNo;
+  return result;
+}
+
+/* **************************************************************
+ * Open database at boot, replays journal of interrupted writes
+ */
+bool slotDbBegin()
+{
+  return slotDbOpen();
+}
+
+/* **************************************************************
+ * Replace database which can't be used with empty one, the old one is
+ * kept as SLOT_DB_BACKUP_FILE
+ * @returns false if database is fine or new one can't be created
+ */
+bool slotDbReset()
+{
+  if (!dbError)
+    return false;
+  sendToDebug("*IR: Slot database reset\n");
+  SPIFFS.remove(SLOT_DB_BACKUP_FILE);
+  if (SPIFFS.exists(SLOT_DB_FILE) && !SPIFFS.rename(SLOT_DB_FILE, SLOT_DB_BACKUP_FILE))
+    return false;
+  SPIFFS.remove(SLOT_DB_JOURNAL_FILE);
+  dbError = NULL;
+  return slotDbOpen();
+}
+
+/* **************************************************************
+ * Write journal into database after SLOT_DB_CHECKPOINT_DELAY without changes
+ */
+void slotDbLoop()
+{
+  if (journalNo > 0 && millis() - journalTime >= SLOT_DB_CHECKPOINT_DELAY)
+    slotDbCheckpoint();
+}
@@ -0,0 +1,104 @@
+#include "globals.h"
+
+/*
+ * Outbound topics
+ *
+ * All fixed topics (_mqtt_prefix_ + SUFFIX_*) are formatted once by
+ * topicsBuild() after configuration is loaded. Receiver topics depend on
+ * decoded protocol, bits and address - RX_TOPICS most recently used ones
+ * are kept, so publishing of repeated codes does no formatting.
+ */
+
+struct RxTopicStruct {
+  decode_type_t type;
+  uint16_t bits;
+  uint32_t address;
+  unsigned long lastUsed; // millis()
+  char topic[TOPIC_SIZE];
+};
+
+static const char * const topicSuffixes[TOPICS_NUMBER] = {
+  SUFFIX_WILL, SUFFIX_SUBSCRIBE, SUFFIX_CMD_RESULT, SUFFIX_RAWMODE_VAL,
+  SUFFIX_RAWFORMAT_VAL, SUFFIX_AUTOSENDMODE_VAL, SUFFIX_TXQUEUE, SUFFIX_METRICS,
+  SUFFIX_BOOT, SUFFIX_CLIENT, SUFFIX_IP, SUFFIX_TYPE, SUFFIX_VERSION,
+  SUFFIX_RECEIVER_RAW, SUFFIX_RECEIVER_RAWB, SUFFIX_RECEIVER_SLOT, SUFFIX_HEALTH
+};
+static_assert(sizeof(mqtt_prefix) + sizeof(SUFFIX_AUTOSENDMODE_VAL) - 1 <= TOPIC_SIZE, "TOPIC_SIZE too small");
+
+static char (&topics)[TOPICS_NUMBER][TOPIC_SIZE] = arena.topics;
+static RxTopicStruct rxTopics[RX_TOPICS];
+static uint8_t rxTopicsNo = 0;
+
+/* **************************************************************
+ * Format fixed topics, called when mqtt_prefix is set
+ */
+void topicsBuild()
+{
+  for (uint8_t i=0;i<TOPICS_NUMBER;i++)
+  {
+    snprintf(topics[i], TOPIC_SIZE, "%s%s", mqtt_prefix, topicSuffixes[i]);
+  }
+  rxTopicsNo = 0;
+}
+
+/* **************************************************************
+ * Fixed topic
+ * - id - TOPIC_*
+ */
+const char *getTopic(uint8_t id)
+{
+  return topics[id];
+}
+
+/* **************************************************************
+ * Receiver topic of capture matching stored slot:
+ * _mqtt_prefix_/receiver/slot/_slot_id_
+ * Valid until next call.
+ */
+const char *getSlotTopic(int slotNo)
+{
+  static char topic[TOPIC_SIZE+4];
+  size_t len = strlen(topics[TOPIC_RECEIVER_SLOT]);
+  memcpy(topic, topics[TOPIC_RECEIVER_SLOT], len);
+  topic[len + uintToStr(slotNo, &topic[len])] = '\0';
+  return topic;
+}
+
+/* **************************************************************
+ * Receiver topic of decoded code:
+ * _mqtt_prefix_/receiver/_type_/_bits_[/_panasonic_address_]
+ */
+const char *getReceiverTopic(decode_results *results)
+{
+  uint32_t address = results->decode_type == PANASONIC ? results->address : 0;
+  uint8_t idx = 0;
+  for (uint8_t i=0;i<rxTopicsNo;i++)
+  {
+    RxTopicStruct &entry = rxTopics[i];
+    if (entry.type == results->decode_type && entry.bits == results->bits && entry.address == address)
+    {
+      entry.lastUsed = millis();
+      return entry.topic;
+    }
+    if (entry.lastUsed < rxTopics[idx].lastUsed)
+      idx = i;
+  }
+  // New topic in free or least recently used place
+  if (rxTopicsNo < RX_TOPICS)
+    idx = rxTopicsNo++;
+  RxTopicStruct &entry = rxTopics[idx];
+  entry.type = results->decode_type;
+  entry.bits = results->bits;
+  entry.address = address;
+  entry.lastUsed = millis();
+  const char *encoding = irProtocol(results->decode_type).name;
+  if (results->decode_type == PANASONIC)
+  { //Panasonic has address
+    snprintf(entry.topic, TOPIC_SIZE, "%s/receiver/%s/%d/%u", mqtt_prefix, encoding, results->bits, address);
+  }
+  else
+  {
+    snprintf(entry.topic, TOPIC_SIZE, "%s/receiver/%s/%d", mqtt_prefix, encoding, results->bits);
+  }
+  return entry.topic;
+}
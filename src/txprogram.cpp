@@ -0,0 +1,102 @@
+#include "globals.h"
+
+/*
+ * Transmit programs
+ *
+ * Slot is compiled when it is loaded into slot cache (right after it is
+ * stored and after cache eviction): mark/space compensation of this
+ * transmitter (EEpromData, set by "calibrate" command) is added to its
+ * durations, so cached slot is ready to be emitted as it is. Carrier is
+ * set up only when its frequency differs from the previous frame - other
+ * senders of IRsend (protocols, GC) reset it.
+ */
+
+static uint16_t txCarrier = 0; // frequency of carrier set up in irsend (kHz), 0 - unknown
+
+/* **************************************************************
+ * Compensation of element of program
+ * - idx - element index (even - mark, odd - space)
+ */
+int16_t txAdjustment(int idx)
+{
+  return (idx & 1) ? EEpromData.spaceAdjust : EEpromData.markAdjust;
+}
+
+/* **************************************************************
+ * Compile durations into transmit program (in place)
+ * - durations[] - marks and spaces, count - number of durations
+ */
+void txProgramCompile(uint16_t durations[], int count)
+{
+  if (EEpromData.markAdjust == 0 && EEpromData.spaceAdjust == 0)
+    return;
+  for (int i=0;i<count;i++)
+  {
+    int32_t value = (int32_t) durations[i] + txAdjustment(i);
+    durations[i] = value < 1 ? 1 : value > 0xFFFF ? 0xFFFF : value;
+  }
+}
+
+/* **************************************************************
+ * Transmit program
+ * - program[] - marks and spaces, count - number of durations
+ * - freq - carrier frequency in kHz
+ */
+void txProgramEmit(const uint16_t program[], uint16_t count, uint16_t freq)
+{
+  if (freq != txCarrier)
+  {
+    irsend.enableIROut(freq);
+    txCarrier = freq;
+  }
+  for (uint16_t i=0;i<count;i++)
+  {
+    if (i & 1)
+      irsend.space(program[i]);
+    else
+      irsend.mark(program[i]);
+  }
+}
+
+/* **************************************************************
+ * Forget carrier set up (other sender changed it)
+ */
+void txProgramCarrierReset()
+{
+  txCarrier = 0;
+}
+
+/* **************************************************************
+ * Calibration command: "calibrate" - show compensation,
+ * "calibrate,mark,space" - set compensation in us (slots are recompiled)
+ * @returns result for SUFFIX_CMD_RESULT
+ */
+String txCalibrate(const char *msg)
+{
+  const char *args = msg + strlen("calibrate");
+  if (*args == ',')
+  {
+    char *end;
+    long markAdjust = strtol(args+1, &end, 10);
+    long spaceAdjust = *end == ',' ? strtol(end+1, &end, 10) : 0;
+    if (*end != '\0' || end == args+1 || markAdjust < -TX_ADJUST_MAX || markAdjust > TX_ADJUST_MAX
+        || spaceAdjust < -TX_ADJUST_MAX || spaceAdjust > TX_ADJUST_MAX)
+      return "Wrong calibration";
+    EEpromData.markAdjust = markAdjust;
+    EEpromData.spaceAdjust = spaceAdjust;
+    EEPROM.put(0, EEpromData);
+    EEPROM.commit();
+    sendToDebug(String("*IR: TX calibration: ")+markAdjust+","+spaceAdjust+"\n");
+    slotCacheClear();
+    loadDefaultIR();
+  }
+  else if (*args != '\0')
+  {
+    return "command unknown";
+  }
+  String result = "Mark adjust=";
+  result += EEpromData.markAdjust;
+  result += ";Space adjust=";
+  result += EEpromData.spaceAdjust;
+  return result;
+}
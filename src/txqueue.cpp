@@ -0,0 +1,350 @@
+#include "globals.h"
+
+/*
+ * IR transmit queue
+ *
+ * All transmissions are queued here and sent by txQueueRun() - one frame per
+ * loop() iteration, separated by the gap of the previous job. RAW and GC codes
+ * from MQTT are copied into txPool, which is used as a ring buffer (jobs are
+ * sent in the same order as their data was allocated). Slot jobs refer to
+ * transmit programs compiled in slot cache, cache keeps them while they are
+ * queued (txQueueHasSlot). Jobs added between txQueueGroupBegin() and
+ * txQueueGroupEnd() (macros, batches) are queued all or none.
+ */
+
+#define TX_JOB_SLOT 1
+#define TX_JOB_RAW  2
+#define TX_JOB_GC   3
+#define TX_JOB_CODE 4
+
+struct TxJobStruct {
+  uint8_t type;
+  uint16_t gap;                 // delay after this frame (ms)
+  uint16_t offset;              // data in txPool (RAW, GC)
+  uint16_t size;                // number of elements (RAW, GC), slot number (SLOT), bits (CODE)
+  uint16_t freq;                // frequency in kHz (RAW)
+  uint8_t repeats;              // number of frames left
+  unsigned long queued;         // micros() when job was queued
+  uint64_t value;               // code (CODE)
+  IRSendFunction sendFunction;  // protocol sender (CODE)
+};
+
+static TxJobStruct txJobs[TX_QUEUE_SIZE];
+static uint8_t txJobsTail = 0;   // oldest job
+static uint8_t txJobsNo = 0;
+static uint16_t (&txPool)[TX_POOL_SIZE] = arena.txPool;
+static uint16_t txPoolHead = 0;  // next free element
+static unsigned long txLastFrame = 0;
+static uint16_t txLastGap = 0;
+static uint8_t txMaxDepth = 0;
+static unsigned long txDropped = 0;
+static unsigned long txRejected = 0;
+static bool txPublishStatus = false;
+static bool txGroup = false;      // group of jobs is being added
+static bool txGroupFailed = false;
+static uint8_t txGroupJobsNo = 0; // queue state before group
+static uint16_t txGroupPoolHead = 0;
+
+/* **************************************************************
+ * Check if job keeps its data in txPool
+ */
+static bool txJobHasData(const TxJobStruct &job)
+{
+  return job.type == TX_JOB_RAW || job.type == TX_JOB_GC;
+}
+
+/* **************************************************************
+ * Remove oldest job from queue
+ */
+static void txQueuePop()
+{
+  txJobsTail = (txJobsTail + 1) % TX_QUEUE_SIZE;
+  txJobsNo--;
+}
+
+/* **************************************************************
+ * Allocate continuous space in txPool
+ * @returns offset, -1 if there is no space
+ */
+static int txPoolAlloc(uint16_t size)
+{
+  int tail = -1;
+  for (uint8_t i=0;i<txJobsNo;i++)
+  {
+    TxJobStruct &job = txJobs[(txJobsTail + i) % TX_QUEUE_SIZE];
+    if (txJobHasData(job))
+    {
+      tail = job.offset;
+      break;
+    }
+  }
+  if (tail == -1)
+  {
+    // Pool is empty
+    txPoolHead = 0;
+    return size <= TX_POOL_SIZE ? 0 : -1;
+  }
+  if (txPoolHead > tail)
+  {
+    if (txPoolHead + size <= TX_POOL_SIZE)
+      return txPoolHead;
+    return size <= tail ? 0 : -1; // wrap to begin
+  }
+  if (txPoolHead < tail && txPoolHead + size <= tail)
+    return txPoolHead;
+  return -1; // pool full (txPoolHead == tail)
+}
+
+/* **************************************************************
+ * Find the same data in jobs of current group (macro sending one slot
+ * several times keeps its durations once)
+ * @returns offset, -1 if not found
+ */
+static int txGroupFindData(const TxJobStruct &job, const uint16_t data[])
+{
+  for (uint8_t i=txGroupJobsNo;i<txJobsNo;i++)
+  {
+    const TxJobStruct &other = txJobs[(txJobsTail + i) % TX_QUEUE_SIZE];
+    if (other.type == job.type && other.size == job.size && other.freq == job.freq
+        && memcmp(&txPool[other.offset], data, job.size*sizeof(uint16_t)) == 0)
+      return other.offset;
+  }
+  return -1;
+}
+
+/* **************************************************************
+ * Add job to queue, handle overflow according to TX_QUEUE_POLICY
+ * - job - job to add (offset is set for RAW/GC jobs)
+ * - data - elements to copy into txPool (RAW/GC jobs)
+ * @returns false if job was rejected
+ */
+static bool txQueueAdd(TxJobStruct &job, const uint16_t data[])
+{
+  int offset = 0;
+  int shared = txGroup && txJobHasData(job) ? txGroupFindData(job, data) : -1;
+  while (true)
+  {
+    if (txJobsNo < TX_QUEUE_SIZE)
+    {
+      offset = shared >= 0 ? shared : txJobHasData(job) ? txPoolAlloc(job.size) : 0;
+      if (offset >= 0)
+        break;
+    }
+    if (TX_QUEUE_POLICY == TX_DROP_OLDEST && !txGroup && txJobsNo > 0 && job.size <= TX_POOL_SIZE)
+    {
+      sendToDebug("*IR: TX queue full - dropping oldest job\n");
+      txQueuePop();
+      txDropped++;
+      txPublishStatus = true;
+    }
+    else
+    {
+      sendToDebug("*IR: TX queue full - job rejected\n");
+      txRejected++;
+      txPublishStatus = true;
+      txGroupFailed = txGroup;
+      return false;
+    }
+  }
+  if (txJobHasData(job))
+  {
+    job.offset = offset;
+    if (shared < 0)
+    {
+      memcpy(&txPool[offset], data, job.size*sizeof(uint16_t));
+      txPoolHead = offset + job.size;
+    }
+  }
+  job.queued = micros();
+  txJobs[(txJobsTail + txJobsNo) % TX_QUEUE_SIZE] = job;
+  txJobsNo++;
+  if (txJobsNo > txMaxDepth)
+    txMaxDepth = txJobsNo;
+  return true;
+}
+
+/* **************************************************************
+ * Queue raw code from slot
+ * - gap - delay after every frame, repeats - number of frames
+ */
+bool txQueueAddSlot(int slotNo, uint16_t gap, uint8_t repeats)
+{
+  if (slotNo<1 || slotNo>SLOTS_NUMBER || repeats == 0)
+    return false;
+  TxJobStruct job;
+  job.type = TX_JOB_SLOT;
+  job.gap = gap;
+  job.repeats = repeats;
+  job.size = slotNo;
+  return txQueueAdd(job, NULL);
+}
+
+/* **************************************************************
+ * Check if slot waits for transmission (its cache entry must be kept)
+ */
+bool txQueueHasSlot(int slotNo)
+{
+  for (uint8_t i=0;i<txJobsNo;i++)
+  {
+    const TxJobStruct &job = txJobs[(txJobsTail + i) % TX_QUEUE_SIZE];
+    if (job.type == TX_JOB_SLOT && job.size == slotNo)
+      return true;
+  }
+  return false;
+}
+
+/* **************************************************************
+ * Queue raw code
+ * - data[] - durations, size - number of durations, freq - frequency in kHz
+ * - gap - delay after every frame, repeats - number of frames
+ */
+bool txQueueAddRaw(const uint16_t data[], uint16_t size, uint16_t freq, uint16_t gap, uint8_t repeats)
+{
+  if (size == 0)
+    return false;
+  TxJobStruct job;
+  job.type = TX_JOB_RAW;
+  job.gap = gap;
+  job.repeats = repeats;
+  job.size = size;
+  job.freq = freq;
+  return txQueueAdd(job, data);
+}
+
+/* **************************************************************
+ * Queue Global Cache code
+ */
+bool txQueueAddGC(const uint16_t data[], uint16_t size, uint16_t gap)
+{
+  if (size == 0)
+    return false;
+  TxJobStruct job;
+  job.type = TX_JOB_GC;
+  job.gap = gap;
+  job.repeats = 1;
+  job.size = size;
+  return txQueueAdd(job, data);
+}
+
+/* **************************************************************
+ * Queue protocol code
+ * - sendFunction - protocol sender, value - code, bits - number of bits
+ */
+bool txQueueAddCode(IRSendFunction sendFunction, uint64_t value, uint16_t bits, uint16_t gap)
+{
+  TxJobStruct job;
+  job.type = TX_JOB_CODE;
+  job.gap = gap;
+  job.repeats = 1;
+  job.size = bits;
+  job.value = value;
+  job.sendFunction = sendFunction;
+  return txQueueAdd(job, NULL);
+}
+
+/* **************************************************************
+ * Start group of jobs - overflow inside group doesn't drop older jobs
+ */
+void txQueueGroupBegin()
+{
+  txGroup = true;
+  txGroupFailed = false;
+  txGroupJobsNo = txJobsNo;
+  txGroupPoolHead = txPoolHead;
+}
+
+/* **************************************************************
+ * Finish group of jobs
+ * - commit - false removes all jobs of group
+ * @returns true if whole group is queued
+ */
+bool txQueueGroupEnd(bool commit)
+{
+  txGroup = false;
+  if (commit && !txGroupFailed)
+    return true;
+  // Jobs of group are at the end of queue, txQueueRun() is not called meanwhile
+  txJobsNo = txGroupJobsNo;
+  txPoolHead = txGroupPoolHead;
+  return false;
+}
+
+/* **************************************************************
+ * Number of waiting jobs
+ */
+int txQueueDepth()
+{
+  return txJobsNo;
+}
+
+/* **************************************************************
+ * Queue status for cmd topic and SUFFIX_TXQUEUE
+ */
+String txQueueInfo()
+{
+  String result = "Depth=";
+  result += txJobsNo;
+  result += ";Max depth=";
+  result += txMaxDepth;
+  result += ";Size=";
+  result += TX_QUEUE_SIZE;
+  result += ";Dropped=";
+  result += txDropped;
+  result += ";Rejected=";
+  result += txRejected;
+  result += ";Policy=";
+  result += TX_QUEUE_POLICY == TX_DROP_OLDEST ? "drop oldest" : "reject";
+  return result;
+}
+
+/* **************************************************************
+ * Scheduler - send one frame from queue, called from loop()
+ */
+void txQueueRun()
+{
+  if (txJobsNo == 0)
+  {
+    if (txPublishStatus && mqttClient.connected())
+    {
+      // Report overflow after queue is drained
+      mqttClient.publish(getTopic(TOPIC_TXQUEUE), txQueueInfo().c_str());
+      txPublishStatus = false;
+    }
+    return;
+  }
+  if (millis() - txLastFrame < txLastGap)
+    return;
+
+  TxJobStruct &job = txJobs[txJobsTail];
+  unsigned long start = micros();
+  metricAdd(METRIC_QUEUE, start - job.queued);
+  #ifdef LED_PIN
+  digitalWrite(LED_PIN, LOW); // LED is on while frame is sent
+  #endif
+  switch (job.type)
+  {
+    case TX_JOB_SLOT:
+      sendStoredSlot(job.size);
+      break;
+    case TX_JOB_RAW:
+      txProgramEmit(&txPool[job.offset], job.size, job.freq);
+      break;
+    case TX_JOB_GC:
+      irsend.sendGC(&txPool[job.offset], job.size);
+      txProgramCarrierReset();
+      break;
+    case TX_JOB_CODE:
+      job.sendFunction(job.value, job.size);
+      txProgramCarrierReset();
+      break;
+  }
+  #ifdef LED_PIN
+  digitalWrite(LED_PIN, HIGH);
+  #endif
+  metricAdd(METRIC_TX, micros() - start);
+  txLastFrame = millis();
+  txLastGap = job.gap;
+  job.queued = micros();
+  if (--job.repeats == 0)
+    txQueuePop();
+}
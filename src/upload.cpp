@@ -0,0 +1,111 @@
+#include "globals.h"
+
+/*
+ * Chunked upload of raw codes
+ *
+ * Codes which don't fit into single MQTT message are sent in parts:
+ *   _mqtt_prefix_/sender/storeRaw/_slot_/part/_n_  msg: "\d+(,\d+)*"
+ *   _mqtt_prefix_/sender/storeRaw/_slot_/commit    msg: "count,checksum[,frequency]"
+ * Parts (numbered from 0, part 0 starts new upload) are parsed one by one
+ * and appended in binary form to UPLOAD_FILE, so only single message is
+ * held in RAM. Commit checks number of durations and checksum (sum of all
+ * durations modulo 65536) and stores code in slot.
+ */
+
+static int uploadSlot = 0;          // 0 - no upload in progress
+static uint16_t uploadNextPart = 0;
+static uint16_t uploadCount = 0;
+static uint16_t uploadSum = 0;
+
+/* **************************************************************
+ * Abort upload
+ */
+static void uploadAbort()
+{
+  uploadSlot = 0;
+  SPIFFS.remove(UPLOAD_FILE);
+}
+
+/* **************************************************************
+ * Append part of code
+ * - slotNo - destination slot
+ * - partNo - part number, 0 starts new upload
+ * - payload, length - comma separated durations
+ * @returns error description, empty string if part was accepted
+ */
+String uploadPart(int slotNo, int partNo, const byte *payload, unsigned int length)
+{
+  if (slotNo<1 || slotNo>SLOTS_NUMBER)
+    return "Wrong slot";
+  if (partNo == 0)
+  {
+    uploadAbort();
+    uploadSlot = slotNo;
+    uploadNextPart = 0;
+    uploadCount = 0;
+    uploadSum = 0;
+  }
+  if (uploadSlot != slotNo || partNo != uploadNextPart)
+  {
+    uploadAbort();
+    return "Part out of order";
+  }
+  int elementIdx = parseNumberList(payload, length, rawIrData, SLOT_SIZE);
+  if (elementIdx<0 || uploadCount + elementIdx > SLOT_SIZE)
+  {
+    uploadAbort();
+    return elementIdx == -1 ? "Wrong message format" : "Code too long";
+  }
+  File file = SPIFFS.open(UPLOAD_FILE, partNo == 0 ? "w" : "a");
+  size_t size = elementIdx*sizeof(uint16_t);
+  bool result = file && file.write((const uint8_t *) rawIrData, size) == size;
+  if (file)
+    file.close();
+  if (!result)
+  {
+    uploadAbort();
+    return "Writing failed";
+  }
+  for (int i=0;i<elementIdx;i++)
+    uploadSum += rawIrData[i];
+  uploadCount += elementIdx;
+  uploadNextPart++;
+  return "";
+}
+
+/* **************************************************************
+ * Store uploaded code in slot
+ * - slotNo - destination slot
+ * - msg - "count,checksum[,frequency]"
+ * @returns result for SUFFIX_CMD_RESULT
+ */
+String uploadCommit(int slotNo, const char *msg)
+{
+  uint16_t values[3];
+  int valuesNo = parseNumberList((const byte *) msg, strlen(msg), values, 3);
+  if (uploadSlot == 0 || uploadSlot != slotNo)
+    return "No upload";
+  if (valuesNo < 2)
+  {
+    uploadAbort();
+    return "Wrong message format";
+  }
+  if (values[0] != uploadCount || values[1] != uploadSum)
+  {
+    uploadAbort();
+    return String("Checksum error;Count=")+uploadCount+";Checksum="+uploadSum;
+  }
+  File file = SPIFFS.open(UPLOAD_FILE, "r");
+  size_t size = uploadCount*sizeof(uint16_t);
+  bool result = file && file.read((uint8_t *) rawIrData, size) == size;
+  if (file)
+    file.close();
+  uploadAbort();
+  if (!result)
+    return "Reading failed";
+  rawIrData[uploadCount] = valuesNo > 2 ? values[2] : TRANSMITTER_FREQ;
+  if (!slotDbWrite(slotNo, rawIrData, uploadCount+1))
+    return "Writing failed";
+  slotCacheUpdate(slotNo);
+  return String("Slot=")+slotNo+";Stored="+uploadCount;
+}
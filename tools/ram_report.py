@@ -0,0 +1,35 @@
+#
+# PlatformIO post build script - static RAM report of firmware
+#
+# Prints size of .data/.bss, static memory arena and the largest variables,
+# so RAM budget changes are visible in every build log.
+#
+import subprocess
+
+Import("env")
+
+TOP_SYMBOLS = 15
+
+
+def ram_report(source, target, env):
+    elf = str(target[0])
+    nm = env.subst("$CC").replace("gcc", "nm")
+    try:
+        output = subprocess.check_output([nm, "-S", "-C", "--size-sort", elf]).decode()
+    except (OSError, subprocess.CalledProcessError) as error:
+        print("RAM report: can't run %s: %s" % (nm, error))
+        return
+    symbols = []
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4 and fields[2] in "bBdD":
+            symbols.append((int(fields[1], 16), fields[2], fields[3]))
+    data = sum(size for size, kind, name in symbols if kind in "dD")
+    bss = sum(size for size, kind, name in symbols if kind in "bB")
+    arena = sum(size for size, kind, name in symbols if name == "arena")
+    print("RAM report: data=%d bss=%d total=%d arena=%d" % (data, bss, data + bss, arena))
+    for size, kind, name in sorted(symbols, reverse=True)[:TOP_SYMBOLS]:
+        print("  %6d %s %s" % (size, kind, name))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", ram_report)